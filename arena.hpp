@@ -0,0 +1,59 @@
+/* Bump allocator for containers that only live for one fuzzer input.
+ *
+ * Deallocation is a no-op. Reset() makes all memory available again in
+ * O(1) but keeps the chunks, so after the first few inputs no further
+ * memory is requested from the system.
+ *
+ * Reset() invalidates everything allocated from the arena; containers
+ * using it must be emptied before it is called.
+ */
+class Arena : public std::pmr::memory_resource {
+    private:
+        static constexpr size_t ChunkSize = 1024 * 1024;
+
+        struct Chunk {
+            std::unique_ptr<uint8_t[]> data;
+            size_t size;
+        };
+
+        std::vector<Chunk> chunks;
+        size_t cur = 0;
+        size_t offset = 0;
+
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            while ( true ) {
+                if ( cur == chunks.size() ) {
+                    const auto size = std::max(ChunkSize, bytes + alignment);
+                    chunks.push_back({std::make_unique<uint8_t[]>(size), size});
+                }
+
+                auto& chunk = chunks[cur];
+                const auto base = reinterpret_cast<uintptr_t>(chunk.data.get());
+                const auto start =
+                    ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+
+                if ( start + bytes <= chunk.size ) {
+                    offset = start + bytes;
+                    return chunk.data.get() + start;
+                }
+
+                cur++;
+                offset = 0;
+            }
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            (void)p;
+            (void)bytes;
+            (void)alignment;
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    public:
+        void Reset(void) {
+            cur = 0;
+            offset = 0;
+        }
+};
@@ -0,0 +1,128 @@
+#include <cstdint>
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <optional>
+#include <map>
+#include <memory_resource>
+#include <memory>
+#include <bit>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+#include <iostream>
+#include <chrono>
+
+#include <boost/algorithm/hex.hpp>
+#include <intx/intx.hpp>
+#include "json.hpp"
+
+extern "C" {
+    #include "xxhash.h"
+    #include "eip4788.h"
+}
+
+using Buffer = std::vector<uint8_t>;
+using uint256 = intx::uint256;
+
+#include "constants.hpp"
+#include "util.hpp"
+#include "storage.hpp"
+
+/* Measures the heap allocations and the time of Storage::Set() and
+ * Storage::Hash() over n slots.
+ *
+ * Every allocation is counted by interposing the allocator (glibc), so
+ * this also sees allocations made by C code such as XXH64_createState().
+ */
+
+static size_t allocations = 0;
+
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t num, size_t size);
+    void* __libc_realloc(void* p, size_t size);
+
+    void* malloc(size_t size) {
+        allocations++;
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t num, size_t size) {
+        allocations++;
+        return __libc_calloc(num, size);
+    }
+
+    void* realloc(void* p, size_t size) {
+        allocations++;
+        return __libc_realloc(p, size);
+    }
+}
+
+template <class F>
+static void measure(const char* name, const size_t n, F f) {
+    const auto allocations_before = allocations;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < n; i++) {
+        f(i);
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    printf("  %-10s %8.3f allocations/op %8.1f ns/op\n",
+            name,
+            static_cast<double>(allocations - allocations_before) / n,
+            static_cast<double>(ns) / n);
+}
+
+/* Returns the number of allocations made by overwriting slots and
+ * hashing, which must be zero
+ */
+template <class StorageT>
+static size_t bench(const char* name, const size_t n) {
+    StorageT storage;
+    uint64_t sink = 0;
+
+    printf("%s, %zu slots:\n", name, n);
+
+    /* Creating a slot may allocate for the backend itself */
+    measure("insert", n, [&](const size_t i) {
+        storage.Set(i, i);
+    });
+
+    const auto allocations_before = allocations;
+    measure("overwrite", n, [&](const size_t i) {
+        storage.Set(i, ~uint256(i));
+    });
+    measure("hash", n, [&](const size_t i) {
+        (void)i;
+        sink += storage.Hash();
+    });
+    const auto ret = allocations - allocations_before;
+
+    /* Keep Hash() from being optimized out */
+    if ( sink == 0 ) {
+        printf("  (fingerprint sum is zero)\n");
+    }
+
+    return ret;
+}
+
+int main(int argc, char** argv) {
+    const size_t n = argc > 1 ?
+        strtoull(argv[1], nullptr, 10) :
+        constants::HISTORICAL_ROOTS_MODULUS[0] * 2;
+    assert(n != 0 && n <= constants::HISTORICAL_ROOTS_MODULUS * 2);
+
+    size_t total = 0;
+    total += bench<Storage>("Storage", n);
+    total += bench<DenseStorage>("DenseStorage", n);
+
+    if ( total != 0 ) {
+        printf("Overwriting and hashing allocated %zu times\n", total);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,302 @@
+/* Codec for the fuzzer input format.
+ *
+ * A format is described by a schema: a constexpr tuple of Field<>s, each
+ * binding a struct member to a wire type. Decode(), Encode() and ToJson()
+ * are generated from the schema, so adding a field to the format only
+ * requires adding it to the schema.
+ */
+namespace codec {
+    /* Reads from the fuzzer input, advancing it as it goes */
+    class Reader {
+        private:
+            const uint8_t** data;
+            size_t& remaining;
+        public:
+            Reader(const uint8_t** data, size_t& remaining) :
+                data(data), remaining(remaining) {
+            }
+
+            std::optional<std::span<const uint8_t>> Take(const size_t size) {
+                if ( remaining < size ) {
+                    return std::nullopt;
+                }
+
+                const std::span<const uint8_t> ret(*data, size);
+                *data += size;
+                remaining -= size;
+                return ret;
+            }
+
+            /* Big-endian unsigned integer */
+            template <class T>
+            std::optional<T> Int(void) {
+                const auto bytes = Take(sizeof(T));
+                if ( bytes == std::nullopt ) return std::nullopt;
+
+                T ret = 0;
+                for (const auto b : *bytes) {
+                    ret = static_cast<T>((ret << 8) | b);
+                }
+                return ret;
+            }
+
+            std::optional<uint256> Word(void) {
+                const auto bytes = Take(32);
+                if ( bytes == std::nullopt ) return std::nullopt;
+
+                return util::load(bytes->data());
+            }
+    };
+
+    /* Appends to a caller-provided buffer */
+    class Writer {
+        private:
+            Buffer& out;
+        public:
+            explicit Writer(Buffer& out) :
+                out(out) {
+            }
+
+            void Bytes(const std::span<const uint8_t> bytes) {
+                out.insert(out.end(), bytes.begin(), bytes.end());
+            }
+
+            /* Big-endian unsigned integer */
+            template <class T>
+            void Int(const T v) {
+                for (size_t i = sizeof(T); i > 0; i--) {
+                    out.push_back(static_cast<uint8_t>(v >> ((i - 1) * 8)));
+                }
+            }
+
+            void Word(const uint256& v) {
+                uint8_t bytes[32];
+                intx::be::unsafe::store(bytes, v);
+                Bytes(bytes);
+            }
+    };
+
+    struct Options {
+        /* Whether storage fills are present in the input */
+        bool fills = true;
+    };
+
+    /* Storage writes injected by the fuzzer before a call. This is a view
+     * of the raw wire records, each consisting of a 2-byte flag (odd), a
+     * 32-byte key and a 32-byte value.
+     */
+    class FillView {
+        private:
+            std::span<const uint8_t> records;
+        public:
+            static constexpr size_t RecordSize = 2 + 32 + 32;
+
+            FillView(void) = default;
+
+            explicit FillView(const std::span<const uint8_t> records) :
+                records(records) {
+                assert(records.size() % RecordSize == 0);
+            }
+
+            size_t Size(void) const {
+                return records.size() / RecordSize;
+            }
+
+            std::span<const uint8_t> Raw(void) const {
+                return records;
+            }
+
+            template <class F>
+            void ForEach(F f) const {
+                for (size_t i = 0; i < records.size(); i += RecordSize) {
+                    f(util::load(&records[i + 2]), util::load(&records[i + 2 + 32]));
+                }
+            }
+    };
+
+    /* Wire types. Each one decodes, encodes and converts to JSON the
+     * value of a single field.
+     */
+    namespace wire {
+        /* 32-byte word of which only the lower 20 bytes are kept */
+        struct Address {
+            using type = uint256;
+
+            static bool Decode(Reader& r, type& out, const Options&) {
+                const auto v = r.Word();
+                if ( v == std::nullopt ) return false;
+
+                out = *v & constants::AddressMask;
+                return true;
+            }
+
+            static void Encode(Writer& w, const type& v, const Options&) {
+                w.Word(v);
+            }
+
+            static nlohmann::json Json(const type& v) {
+                return util::save(v);
+            }
+        };
+
+        /* Byte string prefixed by a 16-bit length */
+        struct Bytes {
+            using type = std::span<const uint8_t>;
+
+            static bool Decode(Reader& r, type& out, const Options&) {
+                const auto size = r.Int<uint16_t>();
+                if ( size == std::nullopt ) return false;
+
+                const auto bytes = r.Take(*size);
+                if ( bytes == std::nullopt ) return false;
+
+                out = *bytes;
+                return true;
+            }
+
+            static void Encode(Writer& w, const type& v, const Options&) {
+                assert(v.size() <= std::numeric_limits<uint16_t>::max());
+                w.Int(static_cast<uint16_t>(v.size()));
+                w.Bytes(v);
+            }
+
+            static nlohmann::json Json(const type& v) {
+                return Buffer(v.begin(), v.end());
+            }
+        };
+
+        /* 64-bit integer, raised to Min if it is smaller */
+        template <uint64_t Min>
+        struct U64AtLeast {
+            using type = uint64_t;
+
+            static bool Decode(Reader& r, type& out, const Options&) {
+                const auto v = r.Int<uint64_t>();
+                if ( v == std::nullopt ) return false;
+
+                out = std::max(*v, Min);
+                return true;
+            }
+
+            static void Encode(Writer& w, const type& v, const Options&) {
+                w.Int(v);
+            }
+
+            static nlohmann::json Json(const type& v) {
+                return v;
+            }
+        };
+
+        /* Zero or more (key, value) records, each preceded by an odd
+         * 16-bit flag, and terminated by an even 16-bit flag
+         */
+        struct Fills {
+            using type = FillView;
+
+            static bool Decode(Reader& r, type& out, const Options& options) {
+                if ( options.fills == false ) {
+                    out = FillView{};
+                    return true;
+                }
+
+                const uint8_t* start = nullptr;
+                size_t size = 0;
+
+                while ( true ) {
+                    const auto flag = r.Take(2);
+                    if ( flag == std::nullopt ) return false;
+                    if ( start == nullptr ) start = flag->data();
+
+                    if ( (*flag)[1] % 2 == 0 ) {
+                        break;
+                    }
+
+                    if ( r.Take(64) == std::nullopt ) return false;
+                    size += FillView::RecordSize;
+                }
+
+                out = FillView({start, size});
+                return true;
+            }
+
+            static void Encode(Writer& w, const type& v, const Options& options) {
+                if ( options.fills == false ) {
+                    assert(v.Size() == 0);
+                    return;
+                }
+
+                w.Bytes(v.Raw());
+                w.Int(static_cast<uint16_t>(0));
+            }
+        };
+    }
+
+    template <auto Member, class Wire>
+    struct Field {
+        /* Name in the JSON representation, or nullptr to omit */
+        const char* name;
+    };
+
+    template <auto Member, class Wire, class T>
+    bool decode_field(
+            const Field<Member, Wire>&,
+            Reader& r,
+            T& v,
+            const Options& options) {
+        return Wire::Decode(r, v.*Member, options);
+    }
+
+    template <auto Member, class Wire, class T>
+    void encode_field(
+            const Field<Member, Wire>&,
+            Writer& w,
+            const T& v,
+            const Options& options) {
+        Wire::Encode(w, v.*Member, options);
+    }
+
+    template <auto Member, class Wire, class T>
+    void json_field(const Field<Member, Wire>& field, const T& v, nlohmann::json& j) {
+        if constexpr ( requires { Wire::Json(v.*Member); } ) {
+            if ( field.name != nullptr ) {
+                j[field.name] = Wire::Json(v.*Member);
+            }
+        }
+    }
+
+    template <class T, class Schema>
+    std::optional<T> Decode(
+            const Schema& schema,
+            Reader& r,
+            const Options& options = {}) {
+        T ret{};
+
+        const bool ok = std::apply([&](const auto&... field) {
+            return (decode_field(field, r, ret, options) && ...);
+        }, schema);
+
+        if ( !ok ) return std::nullopt;
+        return ret;
+    }
+
+    template <class T, class Schema>
+    void Encode(
+            const Schema& schema,
+            const T& v,
+            Buffer& out,
+            const Options& options = {}) {
+        Writer w(out);
+        std::apply([&](const auto&... field) {
+            (encode_field(field, w, v, options), ...);
+        }, schema);
+    }
+
+    template <class T, class Schema>
+    nlohmann::json ToJson(const Schema& schema, const T& v) {
+        nlohmann::json ret;
+        std::apply([&](const auto&... field) {
+            (json_field(field, v, ret), ...);
+        }, schema);
+        return ret;
+    }
+}
@@ -0,0 +1,82 @@
+/* Coverage feedback for libFuzzer beyond what the compiler inserts.
+ *
+ * Every byte in the __libfuzzer_extra_counters section is treated as an
+ * 8-bit counter, like the compiler-inserted ones, and is cleared by
+ * libFuzzer before each input.
+ */
+extern "C" void __sanitizer_cov_trace_cmp8(uint64_t arg1, uint64_t arg2);
+
+namespace coverage {
+    /* Execution of the EIP-4788 bytecode in the Go oracle, filled in by
+     * its tracer; see Tracer.cover() in tracer.go for the layout
+     */
+    __attribute__((section("__libfuzzer_extra_counters")))
+    inline uint8_t go[512];
+
+    /* Semantic events in the C++ model of the contract. Code coverage of
+     * the model saturates quickly; these keep rewarding inputs that reach
+     * new ring buffer states.
+     */
+    enum class Feature : size_t {
+        /* set() wrote a slot that was empty, or held the same, an older
+         * or a newer timestamp
+         */
+        SetEmptySlot,
+        SetSameTimestamp,
+        SetOlderTimestamp,
+        SetNewerTimestamp,
+        /* get() with calldata shorter or longer than 32 bytes */
+        GetShortCalldata,
+        GetLongCalldata,
+        /* get() of a slot that is empty, that was overwritten by a newer
+         * timestamp after wraparound, that holds an older timestamp, or
+         * that holds the requested timestamp
+         */
+        GetEmptySlot,
+        GetOverwritten,
+        GetNotYetSet,
+        GetFound,
+        Count,
+    };
+
+    /* Buckets of timestamp % HISTORICAL_ROOTS_MODULUS, for set() and
+     * get() each
+     */
+    constexpr size_t ResidueBuckets = 64;
+
+    __attribute__((section("__libfuzzer_extra_counters")))
+    inline uint8_t model[static_cast<size_t>(Feature::Count) + 2 * ResidueBuckets];
+
+    inline void Hit(uint8_t& counter) {
+        /* Saturate rather than wrap to zero */
+        if ( counter != 0xFF ) {
+            counter++;
+        }
+    }
+
+    inline void Hit(const Feature feature) {
+        Hit(model[static_cast<size_t>(feature)]);
+    }
+
+    /* idx is a timestamp modulo HISTORICAL_ROOTS_MODULUS */
+    inline void HitResidue(const bool set, const uint256& idx) {
+        const auto bucket = static_cast<size_t>(
+                idx[0] * ResidueBuckets / constants::HISTORICAL_ROOTS_MODULUS[0]);
+        Hit(model[
+                static_cast<size_t>(Feature::Count) +
+                (set ? 0 : ResidueBuckets) +
+                bucket]);
+    }
+
+    /* Report a 256-bit comparison to libFuzzer one 64-bit limb at a time.
+     * intx compares all limbs at once, which libFuzzer cannot see into;
+     * per-limb operands feed its value profile and its table of recent
+     * compares.
+     */
+    inline void TraceCmp(const uint256& a, const uint256& b) {
+        __sanitizer_cov_trace_cmp8(a[0], b[0]);
+        __sanitizer_cov_trace_cmp8(a[1], b[1]);
+        __sanitizer_cov_trace_cmp8(a[2], b[2]);
+        __sanitizer_cov_trace_cmp8(a[3], b[3]);
+    }
+}
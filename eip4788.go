@@ -1,38 +1,55 @@
 package main
 
 import (
+    "github.com/ethereum/go-ethereum/core"
     "github.com/ethereum/go-ethereum/core/vm"
-    "github.com/ethereum/go-ethereum/core/vm/runtime"
     st "github.com/ethereum/go-ethereum/core/state"
     "github.com/ethereum/go-ethereum/core/rawdb"
     "github.com/ethereum/go-ethereum/common"
     "github.com/ethereum/go-ethereum/params"
     "github.com/cespare/xxhash/v2"
+    "math"
     "math/big"
-    "encoding/json"
-    "encoding/hex"
-    "sort"
-    "golang.org/x/exp/slices"
+    "encoding/binary"
+    "runtime"
+    "runtime/cgo"
+    "runtime/debug"
+    "sync"
+    "sync/atomic"
 )
 
 import "C"
 
+type Slot struct {
+    Key common.Hash
+    Value common.Hash
+}
+
 type Input struct {
-    Caller []byte
+    Caller common.Address
     CallData []byte
-    Storage map[string]string
+    Fills []Slot
     Timestamp uint64
     BlockNumber uint64
 }
 
 type ReturnValue struct {
     Reverted bool
-    Data string
+    Data []byte
+}
+
+/* A single storage access. For reads, Old == New. */
+type Access struct {
+    Key common.Hash
+    Old common.Hash
+    New common.Hash
 }
 
 type ExecutionResult struct {
     Ret ReturnValue
     Hash uint64
+    Reads []Access
+    Writes []Access
 }
 
 var eip4788_contract_code = []byte{
@@ -48,7 +65,82 @@ var eip4788_contract_code = []byte{
 
 var BEACON_ROOTS_ADDRESS = common.HexToAddress("0xbEac00dDB15f3B6d645C48263dC93862413A222D")
 
-var state* st.StateDB
+/* State with only the EIP-4788 contract deployed. It is built once and
+ * every request starts from a copy of it.
+ */
+var pristine* st.StateDB
+var pristineLock sync.Mutex
+
+/* Fork rules that every EVM is created with */
+var rules params.Rules
+
+var zero = new(big.Int)
+
+/* An independent instance of the oracle. Instances only share the
+ * pristine state, so different instances can run on different threads
+ * at the same time.
+ */
+type Oracle struct {
+    state* st.StateDB
+
+    /* The StateDB seen by the EVM, wrapping state */
+    tracked trackedState
+
+    /* The EVM is created once and reused for every call; only the block
+     * number, timestamp, origin and state change between calls. Jump
+     * destination analysis is cached per top-level contract in this
+     * version of Geth, so it is still redone for every call.
+     */
+    evm* vm.EVM
+
+    /* Sum of slotDigest() over all storage slots of BEACON_ROOTS_ADDRESS.
+     * Must match Storage::Hash() in storage.hpp.
+     */
+    fingerprint uint64
+
+    /* Current value of every slot of BEACON_ROOTS_ADDRESS that was
+     * written since the last reset, so that the fingerprint can be
+     * updated without looking the slot up in the StateDB
+     */
+    slots map[common.Hash]common.Hash
+
+    /* Every distinct caller since the last reset */
+    callers map[common.Address]struct{}
+
+    /* Storage accesses of BEACON_ROOTS_ADDRESS during the current call */
+    reads, writes []Access
+}
+
+func newOracle() *Oracle {
+    o := &Oracle{
+        slots: map[common.Hash]common.Hash{},
+        callers: map[common.Address]struct{}{},
+    }
+    o.tracked.oracle = o
+
+    /* Same defaults as runtime.Call() */
+    blockContext := vm.BlockContext{
+        CanTransfer: core.CanTransfer,
+        Transfer: core.Transfer,
+        GetHash: func(uint64) common.Hash { return common.Hash{} },
+        BlockNumber: new(big.Int).Set(params.MainnetChainConfig.LondonBlock),
+        Time: *params.MainnetChainConfig.ShanghaiTime,
+        Difficulty: new(big.Int),
+        GasLimit: math.MaxUint64,
+        BaseFee: big.NewInt(params.InitialBaseFee),
+    }
+    o.evm = vm.NewEVM(
+        blockContext,
+        vm.TxContext{GasPrice: zero},
+        nil,
+        params.MainnetChainConfig,
+        vm.Config{
+            Tracer: newTracer(o),
+        },
+    )
+
+    return o
+}
 
 func init() {
     // Vim regex to convert assembly listing in eip-4788.md
@@ -123,160 +215,422 @@ func init() {
         /* stop */ vm.STOP,
     }
 
-    found := map[vm.OpCode]bool{}
-    whitelist_uniq := []vm.OpCode{}
     for _, v := range whitelist {
-        if !found[v] {
-            found[v] = true
-            whitelist_uniq = append(whitelist_uniq, v)
-        }
+        opcode_whitelist[v] = true
+    }
+
+    pristine, _ = st.New(common.Hash{}, st.NewDatabase(rawdb.NewMemoryDatabase()), nil)
+    pristine.SetCode(BEACON_ROOTS_ADDRESS, eip4788_contract_code)
+
+    rules = params.MainnetChainConfig.Rules(
+        params.MainnetChainConfig.LondonBlock,
+        false,
+        *params.MainnetChainConfig.ShanghaiTime)
+
+    /* Each EVM keeps the rules it was created with. Inputs start at
+     * London and Shanghai, so these rules apply to every input as long
+     * as no later fork is scheduled. Rules() allocates a new ChainID on
+     * every call, so only the fork flags are compared.
+     */
+    last := params.MainnetChainConfig.Rules(new(big.Int).SetUint64(math.MaxUint64), false, math.MaxUint64)
+    last.ChainID = rules.ChainID
+    if last != rules {
+        panic("A fork after Shanghai is scheduled")
     }
 
-    opcode_whitelist = whitelist_uniq
+    tracerMode = tracerModeFromEnv()
 }
 
-var result []byte
-var callers []common.Address
+func newAccess(key, old, value common.Hash) Access {
+    return Access{Key: key, Old: old, New: value}
+}
 
-//export Native_Eip4788_Result
-func Native_Eip4788_Result() *C.char {
-    return C.CString(string(result))
+/* Reads a request. All integers are big-endian. */
+type reader struct {
+    data []byte
 }
 
-//export Native_Eip4788_Reset
-func Native_Eip4788_Reset() {
-    state, _ = st.New(common.Hash{}, st.NewDatabase(rawdb.NewMemoryDatabase()), nil)
-    state.SetCode(BEACON_ROOTS_ADDRESS, eip4788_contract_code)
-    callers = []common.Address{}
+func (r *reader) take(n int) []byte {
+    if len(r.data) < n {
+        panic("Truncated request")
+    }
+    ret := r.data[:n]
+    r.data = r.data[n:]
+    return ret
 }
 
-var opcode_whitelist []vm.OpCode
+func (r *reader) u16() uint16 {
+    return binary.BigEndian.Uint16(r.take(2))
+}
 
-func sortedStorageKeys(state *st.StateDB) []common.Hash {
-    var storageKeys []common.Hash
+func (r *reader) u64() uint64 {
+    return binary.BigEndian.Uint64(r.take(8))
+}
 
-    /* Retrieve the storage keys */
-    for key := range state.GetStateObjects()[BEACON_ROOTS_ADDRESS].GetDirtyStorage() {
-        storageKeys = append(storageKeys, key)
+func (r *reader) hash() common.Hash {
+    return common.BytesToHash(r.take(32))
+}
+
+/* Decode a single call of a request. A request is a sequence of calls
+ * in the fuzzer input format (see InputSchema in structs.hpp):
+ *
+ *   caller      32 bytes
+ *   calldata    16-bit length, followed by the calldata
+ *   fills       (odd 16-bit flag, 32-byte key, 32-byte value)*,
+ *               followed by an even 16-bit flag
+ *               These are only the slots injected before this call; the
+ *               state persists across the calls of a request.
+ *   timestamp   64 bits
+ *   blocknumber 64 bits
+ *
+ * CallData points into data.
+ */
+func decodeInput(r *reader) Input {
+    var input Input
+
+    input.Caller = common.BytesToAddress(r.take(32))
+    input.CallData = r.take(int(r.u16()))
+    for r.u16() % 2 == 1 {
+        key := r.hash()
+        value := r.hash()
+        input.Fills = append(input.Fills, Slot{Key: key, Value: value})
+    }
+    input.Timestamp = r.u64()
+    input.BlockNumber = r.u64()
+
+    return input
+}
+
+/* Writes a response into a caller-provided buffer. All integers are
+ * big-endian.
+ */
+type writer struct {
+    out []byte
+    n int
+
+    /* Set once a write did not fit; everything after it is dropped */
+    overflow bool
+}
+
+func (w *writer) bytes(b []byte) {
+    if w.overflow || w.n + len(b) > len(w.out) {
+        w.overflow = true
+        return
     }
+    copy(w.out[w.n:], b)
+    w.n += len(b)
+}
 
-    /* Sort the storage keys */
-    sort.Slice(storageKeys, func(i, j int) bool {
-        return common.Hash.Cmp(storageKeys[i], storageKeys[j]) < 0
-    })
+func (w *writer) u8(v uint8) {
+    w.bytes([]byte{v})
+}
 
-    return storageKeys
+func (w *writer) u32(v uint32) {
+    var b [4]byte
+    binary.BigEndian.PutUint32(b[:], v)
+    w.bytes(b[:])
 }
 
-func hashStorage(state *st.StateDB) uint64 {
-    h := xxhash.New()
+func (w *writer) u64(v uint64) {
+    var b [8]byte
+    binary.BigEndian.PutUint64(b[:], v)
+    w.bytes(b[:])
+}
 
-    /* Hash the storage keys and values */
-    for _, k := range sortedStorageKeys(state) {
-        v := state.GetState(BEACON_ROOTS_ADDRESS, k)
-        h.Write(k.Bytes())
-        h.Write(v.Bytes())
+func (w *writer) accesses(accesses []Access) {
+    w.u8(uint8(len(accesses)))
+    for _, a := range accesses {
+        w.bytes(a.Key[:])
+        w.bytes(a.Old[:])
+        w.bytes(a.New[:])
     }
+}
+
+/* Encode the result of a single call. Must match
+ * ExecutionResult::FromBinary() in structs.hpp:
+ *
+ *   reverted    8 bits (0 or 1)
+ *   hash        64 bits
+ *   data        32-bit length, followed by the return data
+ *   reads       8-bit count, followed by (key, old, new) 32 bytes each
+ *   writes      8-bit count, followed by (key, old, new) 32 bytes each
+ */
+func (res *ExecutionResult) encode(w *writer) {
+    if res.Ret.Reverted {
+        w.u8(1)
+    } else {
+        w.u8(0)
+    }
+    w.u64(res.Hash)
+    w.u32(uint32(len(res.Ret.Data)))
+    w.bytes(res.Ret.Data)
+    w.accesses(res.Reads)
+    w.accesses(res.Writes)
+}
 
-    return h.Sum64()
+/* RevertToSnapshot() is not used here: reverting a storage write leaves
+ * the key in the dirty storage, which updateFingerprint() and
+ * storageInvariants() rely on to tell which slots were written.
+ */
+func (o *Oracle) reset() {
+    pristineLock.Lock()
+    o.state = pristine.Copy()
+    pristineLock.Unlock()
+
+    o.tracked.StateDB = o.state
+    clear(o.slots)
+    clear(o.callers)
+    o.fingerprint = 0
 }
 
-func getStorageAddresses(state *st.StateDB) []common.Address {
-    var storageAddresses []common.Address
+var opcode_whitelist [256]bool
 
-    for address := range state.GetStateObjects() {
-        storageAddresses = append(storageAddresses, address)
+/* Digest of a single storage slot: XXH64(key || value) */
+func slotDigest(key, value common.Hash) uint64 {
+    var kv [2 * common.HashLength]byte
+    copy(kv[:common.HashLength], key[:])
+    copy(kv[common.HashLength:], value[:])
+    return xxhash.Sum64(kv[:])
+}
+
+/* Account for a write of value to key in the fingerprint */
+func (o *Oracle) updateFingerprint(key, value common.Hash) {
+    /* A key that was written before contributes its current value */
+    if old, ok := o.slots[key]; ok {
+        o.fingerprint -= slotDigest(key, old)
     }
+    o.fingerprint += slotDigest(key, value)
+    o.slots[key] = value
+}
 
-    return storageAddresses
+/* The StateDB seen by the EVM. It records the storage accesses of
+ * BEACON_ROOTS_ADDRESS and keeps the fingerprint up to date, so that
+ * this does not depend on a tracer being installed.
+ */
+type trackedState struct {
+    *st.StateDB
+    oracle *Oracle
 }
 
-func storageInvariants(storageAddresses, callers []common.Address) {
-    /* Assert that the EIP-4788 only changes its own storage */
+func (s *trackedState) GetState(addr common.Address, key common.Hash) common.Hash {
+    value := s.StateDB.GetState(addr, key)
+    if addr == BEACON_ROOTS_ADDRESS {
+        s.oracle.reads = append(s.oracle.reads, newAccess(key, value, value))
+    }
+    return value
+}
 
-    /* Iterate through all the addresses whose storage is set */
-    for _, address := range storageAddresses {
-        /* The storage of BEACON_ROOTS_ADDRESS is hashed elsewhere and
-         * compared to the hash of the alternative implementation; any
-         * discrepancies will be detected there.
+func (s *trackedState) SetState(addr common.Address, key, value common.Hash) {
+    o := s.oracle
+    if addr == BEACON_ROOTS_ADDRESS {
+        /* The SSTORE gas calculation reads the slot right before it is
+         * written. That read is not an SLOAD, so it is turned into the
+         * old value of the write instead.
          */
-        if common.Address.Cmp(address, BEACON_ROOTS_ADDRESS) == 0 {
-            continue
+        if len(o.reads) == 0 || o.reads[len(o.reads) - 1].Key != key {
+            panic("SSTORE not preceded by its gas calculation")
         }
+        old := o.reads[len(o.reads) - 1].Old
+        o.reads = o.reads[:len(o.reads) - 1]
 
-        isCaller := slices.Contains(callers, address)
-        if isCaller {
-            /* It is expected that runtime.Call() will create a storage object
-             * for caller. However, it must be empty. If it is not empty,
-             * this implies that the EIP-4788 invocation somehow altered
-             * a storage object that is not its own.
-             */
-            if len(state.GetStateObjects()[address].GetDirtyStorage()) != 0 {
-                panic("Caller storage should be empty")
-            }
-        } else {
-            /* Any modifications to storage objects that do not belong to
-             * BEACON_ROOTS_ADDRESS or any of the callers implies a bug.
-             */
-            panic("Contract altered storage at address other than itself")
+        if o.slots[key] != old {
+            panic("Slot index out of sync with the StateDB")
         }
+
+        o.writes = append(o.writes, newAccess(key, old, value))
+        o.updateFingerprint(key, value)
+    } else {
+        /* This includes the storage of the callers, which must stay
+         * empty.
+         */
+        panic("Contract altered storage at address other than itself")
     }
+    s.StateDB.SetState(addr, key, value)
 }
 
-//export Native_Eip4788_Run
-func Native_Eip4788_Run(data []byte) {
-    /* Reset result */
-    result = []byte{}
+func (o *Oracle) setStorage(key, value common.Hash) {
+    o.updateFingerprint(key, value)
+    o.state.SetState(BEACON_ROOTS_ADDRESS, key, value)
+}
 
-    var input Input
-    err := json.Unmarshal(data, &input)
-    if err != nil {
-        panic("Cannot load JSON")
+/* Assert that the EIP-4788 only changes its own storage.
+ *
+ * Storage writes to any address other than BEACON_ROOTS_ADDRESS are
+ * caught by trackedState.SetState() as they happen. What is left is to
+ * check that the call did not create state objects for other accounts.
+ */
+func (o *Oracle) storageInvariants() {
+    /* It is expected that the call creates a state object for each
+     * caller, and that BEACON_ROOTS_ADDRESS has one. Any other state
+     * object implies that the EIP-4788 invocation somehow altered an
+     * account that is not its own.
+     */
+    expected := len(o.callers)
+    if _, ok := o.callers[BEACON_ROOTS_ADDRESS]; !ok {
+        expected++
     }
 
-    caller := common.BytesToAddress(input.Caller)
-    if slices.Contains(callers, caller) == false {
-        callers = append(callers, caller)
+    if len(o.state.GetStateObjects()) != expected {
+        panic("Contract altered state at address other than itself or a caller")
     }
+}
 
-    for key, value := range input.Storage {
-        state.SetState(
-            BEACON_ROOTS_ADDRESS,
-            common.HexToHash(key),
-            common.HexToHash(value))
+func (o *Oracle) run(input Input) ExecutionResult {
+    o.reads = []Access{}
+    o.writes = []Access{}
+
+    caller := input.Caller
+    o.callers[caller] = struct{}{}
+
+    for _, slot := range input.Fills {
+        o.setStorage(slot.Key, slot.Value)
     }
 
-    returndata, _, err := runtime.Call(
+    evm := o.evm
+    evm.Context.BlockNumber.SetUint64(input.BlockNumber)
+    evm.Context.Time = input.Timestamp
+    if input.BlockNumber < params.MainnetChainConfig.LondonBlock.Uint64() ||
+        input.Timestamp < *params.MainnetChainConfig.ShanghaiTime {
+        panic("Input predates the fork rules the EVM was created with")
+    }
+    evm.Reset(vm.TxContext{Origin: caller, GasPrice: zero}, &o.tracked)
+
+    /* What runtime.Call() does, minus creating the EVM */
+    sender := o.state.GetOrNewStateObject(caller)
+    o.state.Prepare(rules, caller, common.Address{}, &BEACON_ROOTS_ADDRESS, vm.ActivePrecompiles(rules), nil)
+    returndata, _, err := evm.Call(
+        sender,
         BEACON_ROOTS_ADDRESS,
         input.CallData,
-        &runtime.Config{
-            Origin: caller,
-            State: state,
-            ChainConfig: params.MainnetChainConfig,
-            GasLimit: 0,
-            BlockNumber: new(big.Int).SetUint64(input.BlockNumber),
-            Time: input.Timestamp,
-            EVMConfig: vm.Config{
-                Tracer: &Tracer{},
-            },
-        },
+        math.MaxUint64,
+        zero,
     )
 
-    storageInvariants(getStorageAddresses(state), callers)
+    o.storageInvariants()
 
-    if returndata == nil {
-        returndata = []byte{}
-    }
-
-    result, err = json.Marshal(&ExecutionResult{
+    return ExecutionResult{
         Ret : ReturnValue {
             Reverted: err == vm.ErrExecutionReverted,
-            Data: hex.EncodeToString(returndata),
+            Data: returndata,
         },
-        Hash : hashStorage(state),
-    })
-    if err != nil {
-        panic("Cannot save JSON")
+        Hash : o.fingerprint,
+        Reads : o.reads,
+        Writes : o.writes,
     }
 }
+
+/* Run all calls of a fuzzer input, starting from a fresh state, and
+ * write their results to out:
+ *
+ *   count       32 bits
+ *   results     count results, see ExecutionResult.encode()
+ *
+ * Returns the number of bytes written, or -1 if the results do not fit
+ * in out. The harness sizes out for the largest result EIP-4788 can
+ * produce, so that is reported as a mismatch rather than a panic.
+ */
+func (o *Oracle) runBatch(data []byte, out []byte) int {
+    o.reset()
+
+    r := reader{data}
+    w := writer{out: out}
+
+    /* Filled in at the end */
+    w.u32(0)
+
+    var count uint32
+    for len(r.data) != 0 && !w.overflow {
+        result := o.run(decodeInput(&r))
+        result.encode(&w)
+        count++
+    }
+
+    if !w.overflow {
+        binary.BigEndian.PutUint32(out[:4], count)
+    }
+
+    n := batches.Add(1)
+    if every := gcEvery.Load(); every != 0 && n % every == 0 {
+        runtime.GC()
+    }
+
+    if w.overflow {
+        return -1
+    }
+    return w.n
+}
+
+/* Create an oracle and return a handle to it */
+//export Native_Eip4788_New
+func Native_Eip4788_New() uintptr {
+    return uintptr(cgo.NewHandle(newOracle()))
+}
+
+/* Free an oracle created by Native_Eip4788_New(). It must not be running
+ * a batch.
+ */
+//export Native_Eip4788_Free
+func Native_Eip4788_Free(handle uintptr) {
+    cgo.Handle(handle).Delete()
+}
+
+/* See runBatch(). An oracle runs one batch at a time, but different
+ * oracles may run concurrently.
+ */
+//export Native_Eip4788_RunBatch
+func Native_Eip4788_RunBatch(handle uintptr, data []byte, out []byte) int {
+    return cgo.Handle(handle).Value().(*Oracle).runBatch(data, out)
+}
+
+/* The remaining functions apply to the whole process: the Go runtime is
+ * shared by all oracles.
+ */
+
+/* Number of batches run, and the interval at which a collection is
+ * forced after a batch (0: never)
+ */
+var batches, gcEvery atomic.Uint64
+
+/* Passed as gcPercent to leave the GC percent as it is. Must match
+ * GoGcPercentUnchanged in harness-differential.hpp.
+ */
+const gcPercentUnchanged = math.MinInt64
+
+/* Set the soft memory limit in bytes (math.MaxInt64: no limit, negative:
+ * unchanged), the GC percent (negative: disable the collector,
+ * gcPercentUnchanged: unchanged) and the forced collection interval in
+ * batches (0: never). What is left unchanged keeps the value from
+ * GOMEMLIMIT and GOGC.
+ */
+//export Native_Eip4788_Configure
+func Native_Eip4788_Configure(memoryLimit int64, gcPercent int, every uint64) {
+    /* A negative limit only reads the current one */
+    debug.SetMemoryLimit(memoryLimit)
+    if gcPercent != gcPercentUnchanged {
+        debug.SetGCPercent(gcPercent)
+    }
+    gcEvery.Store(every)
+}
+
+/* Write heap statistics to out as big-endian 64-bit integers and return
+ * the number of bytes written:
+ *
+ *   batches, HeapAlloc, HeapSys, NumGC, PauseTotalNs
+ *
+ * This stops the world, so it should not be called per input.
+ */
+//export Native_Eip4788_Stats
+func Native_Eip4788_Stats(out []byte) int {
+    var m runtime.MemStats
+    runtime.ReadMemStats(&m)
+
+    w := writer{out: out}
+    w.u64(batches.Load())
+    w.u64(m.HeapAlloc)
+    w.u64(m.HeapSys)
+    w.u64(uint64(m.NumGC))
+    w.u64(m.PauseTotalNs)
+
+    return w.n
+}
 func main() { }
@@ -1,6 +1,8 @@
 class Eip4788 {
     public:
-        static ReturnValue run(const Input& input, Storage& storage) {
+        template <class StorageT>
+        static ReturnValue run(const InputView& input, StorageT& storage) {
+            coverage::TraceCmp(input.caller, constants::SYSTEM_ADDRESS);
             if ( input.caller == constants::SYSTEM_ADDRESS ) {
                 return set(input, storage);
             } else {
@@ -8,8 +10,12 @@ class Eip4788 {
             }
         }
 
-        static ReturnValue get(const Input& input, const Storage& storage) {
+        template <class StorageT>
+        static ReturnValue get(const InputView& input, const StorageT& storage) {
             if ( input.calldata.size() != 32 ) {
+                coverage::Hit(input.calldata.size() < 32 ?
+                        coverage::Feature::GetShortCalldata :
+                        coverage::Feature::GetLongCalldata);
                 return ReturnValue::revert();
             }
 
@@ -19,10 +25,20 @@ class Eip4788 {
                 calldata_u256 %
                 constants::HISTORICAL_ROOTS_MODULUS;
             const auto timestamp = storage.Get(timestamp_idx, true);
+            coverage::HitResidue(false, timestamp_idx);
 
+            coverage::TraceCmp(timestamp, calldata_u256);
             if ( timestamp != calldata_u256 ) {
+                if ( timestamp == 0 ) {
+                    coverage::Hit(coverage::Feature::GetEmptySlot);
+                } else if ( timestamp > calldata_u256 ) {
+                    coverage::Hit(coverage::Feature::GetOverwritten);
+                } else {
+                    coverage::Hit(coverage::Feature::GetNotYetSet);
+                }
                 return ReturnValue::revert();
             }
+            coverage::Hit(coverage::Feature::GetFound);
 
             const auto root_idx = util::checked_add(
                     timestamp_idx,
@@ -35,7 +51,8 @@ class Eip4788 {
             return ReturnValue::value(root);
         }
 
-        static ReturnValue set(const Input& input, Storage& storage) {
+        template <class StorageT>
+        static ReturnValue set(const InputView& input, StorageT& storage) {
             const auto timestamp_idx =
                 uint256(input.timestamp) %
                 constants::HISTORICAL_ROOTS_MODULUS;
@@ -45,8 +62,19 @@ class Eip4788 {
 
             assert(timestamp_idx < root_idx);
 
-            storage.Set(timestamp_idx, input.timestamp, true);
+            const auto prev = storage.Set(timestamp_idx, input.timestamp, true);
             storage.Set(root_idx, util::load(input.calldata), true);
+
+            coverage::HitResidue(true, timestamp_idx);
+            if ( prev == 0 ) {
+                coverage::Hit(coverage::Feature::SetEmptySlot);
+            } else if ( prev == input.timestamp ) {
+                coverage::Hit(coverage::Feature::SetSameTimestamp);
+            } else if ( prev < input.timestamp ) {
+                coverage::Hit(coverage::Feature::SetOlderTimestamp);
+            } else {
+                coverage::Hit(coverage::Feature::SetNewerTimestamp);
+            }
             return ReturnValue::value(Buffer{});
         }
 };
@@ -47,19 +47,23 @@ def to_uint256_be(v):
 class Storage(object):
     def __init__(self, kv):
         self.map = {}
+        self.reads = []
+        self.writes = []
         if kv == None:
             return
         for k, v in kv.items():
             self.set(Uint256(k), Uint256(v))
+        # Only record accesses made by the contract
+        self.reads = []
+        self.writes = []
 
     def get(self, address):
         if isinstance(address, Uint256):
             address = address.v
 
-        if address in self.map:
-            return Uint256(self.map[address])
-        else:
-            return Uint256(0)
+        value = self.map.get(address, 0)
+        self.reads.append((address, value, value))
+        return Uint256(value)
     def set(self, address, value):
         if isinstance(address, Uint256):
             address = address.v
@@ -71,12 +75,17 @@ class Storage(object):
             value += b'\x00' * (32 - len(value))
             value = to_uint256_be(value)
             value = value.v
+        self.writes.append((address, self.map.get(address, 0), value))
         self.map[address] = value
     def get_map(self):
         ret = {}
         for k, v in self.map.items():
             ret[str(k)] = str(v)
         return ret
+    @staticmethod
+    def accesses_to_json(accesses):
+        return [{'Key': '%064x' % k, 'Old': '%064x' % o, 'New': '%064x' % n}
+                for k, o, n in accesses]
 
 # Mock EVM
 class EVM(object):
@@ -111,6 +120,8 @@ class EVM(object):
         j['Ret']['Data'] = self.returndata.hex()
         j['Hash'] = 0
         j['Storage'] = self.storage.get_map()
+        j['Reads'] = Storage.accesses_to_json(self.storage.reads)
+        j['Writes'] = Storage.accesses_to_json(self.storage.writes)
         return json.dumps(j).encode('utf-8')
 
 def Eip4788(evm):
@@ -1,42 +1,259 @@
 namespace harness {
     namespace differential {
+        /* The input contains storage fills */
+        constexpr codec::Options InputOptions{.fills = true};
+
+        /* Upper bound of the size of a single result in the response of
+         * the Go oracle: the return data of EIP-4788 is at most 32 bytes,
+         * and a call accesses at most 4 slots.
+         */
+        constexpr size_t MaxResultSize = 1 + 8 + 4 + 32 + 2 * (1 + 4 * 3 * 32);
+
+        /* Arguments of Native_Eip4788_Configure() that leave a setting as
+         * it is. The GC percent one must match gcPercentUnchanged in
+         * eip4788.go.
+         */
+        constexpr int64_t GoMemoryLimitUnchanged = -1;
+        constexpr int64_t GoGcPercentUnchanged = std::numeric_limits<int64_t>::min();
+
+        inline int64_t EnvInt(const char* name, const int64_t def) {
+            const char* v = getenv(name);
+            return v == nullptr ? def : strtoll(v, nullptr, 10);
+        }
+
+        inline void PrintGoStats(void) {
+            uint8_t out[5 * 8];
+            const auto size = Native_Eip4788_Stats(util::ToGoSlice(out, sizeof(out)));
+
+            const uint8_t* p = out;
+            size_t remaining = static_cast<size_t>(size);
+            codec::Reader r(&p, remaining);
+
+            const char* names[] = {
+                "inputs", "heap alloc", "heap sys", "collections", "pause total ns"};
+            std::cerr << "Go oracle:";
+            for (const auto name : names) {
+                const auto v = r.Int<uint64_t>();
+                assert(v != std::nullopt);
+                std::cerr << " " << name << " " << *v;
+            }
+            std::cerr << std::endl;
+        }
+
+        /* Configure the Go runtime from the environment:
+         *
+         *   EIP4788_GO_MEMORY_LIMIT  soft memory limit in bytes
+         *   EIP4788_GO_GC_PERCENT    GOGC; negative disables the collector
+         *   EIP4788_GO_GC_EVERY      force a collection every N inputs
+         *
+         * The memory limit and GC percent are only set if their variable
+         * is, so GOMEMLIMIT and GOGC apply otherwise.
+         *
+         * Go heap statistics, and the Go tracer profile if enabled
+         * (EIP4788_TRACER=profile), are printed on exit.
+         *
+         * The Go tracer records bytecode coverage into coverage::go.
+         */
+        inline void Initialize(void) {
+            Native_Eip4788_Configure(
+                    EnvInt("EIP4788_GO_MEMORY_LIMIT", GoMemoryLimitUnchanged),
+                    EnvInt("EIP4788_GO_GC_PERCENT", GoGcPercentUnchanged),
+                    EnvInt("EIP4788_GO_GC_EVERY", 0));
+
+            Native_Eip4788_SetCoverage(
+                    util::ToGoSlice(coverage::go, sizeof(coverage::go)));
+
+            atexit(PrintGoStats);
+            atexit(Native_Eip4788_PrintProfile);
+        }
+
+        /* Owns an instance of the Go oracle. Instances are independent,
+         * so each thread can have its own.
+         */
+        class GoHandle {
+            private:
+                const GoUintptr handle;
+            public:
+                GoHandle(void) :
+                    handle(Native_Eip4788_New()) {
+                }
+
+                ~GoHandle(void) {
+                    Native_Eip4788_Free(handle);
+                }
+
+                GoHandle(const GoHandle&) = delete;
+                GoHandle& operator=(const GoHandle&) = delete;
+
+                /* Returns the size of the response, or std::nullopt if it
+                 * did not fit
+                 */
+                std::optional<size_t> RunBatch(Buffer& request, Buffer& response) const {
+                    const auto size = Native_Eip4788_RunBatch(
+                            handle,
+                            util::ToGoSlice(request.data(), request.size()),
+                            util::ToGoSlice(response.data(), response.size()));
+                    if ( size < 0 ) return std::nullopt;
+                    return static_cast<size_t>(size);
+                }
+        };
+
+        /* Runs batches on the Go oracle in the calling thread. Submit()
+         * only records the batch; Wait() runs it.
+         */
+        class InlineOracle {
+            private:
+                GoHandle go;
+                Buffer* request = nullptr;
+                Buffer* response = nullptr;
+            public:
+                void Submit(Buffer& request_, Buffer& response_) {
+                    request = &request_;
+                    response = &response_;
+                }
+
+                /* See GoHandle::RunBatch() */
+                std::optional<size_t> Wait(void) {
+                    return go.RunBatch(*request, *response);
+                }
+        };
+
+        /* Runs batches on the Go oracle in a worker thread, so that the
+         * other implementations run while Go executes. The buffers passed
+         * to Submit() must not be touched until Wait() returns.
+         */
+        class PipelinedOracle {
+            private:
+                struct Job {
+                    size_t seq;
+                    Buffer* request;
+                    Buffer* response;
+                };
+
+                struct Done {
+                    size_t seq;
+                    std::optional<size_t> size;
+                };
+
+                GoHandle go;
+                SpscQueue<Job, 2> jobs;
+                SpscQueue<Done, 2> done;
+                size_t seq = 0;
+                std::thread worker;
+            public:
+                PipelinedOracle(void) {
+                    worker = std::thread([this](void) {
+                        while ( true ) {
+                            const auto job = jobs.Pop();
+                            /* Stop request from the destructor */
+                            if ( job.request == nullptr ) break;
+
+                            const auto size = go.RunBatch(*job.request, *job.response);
+                            done.Push({job.seq, size});
+                        }
+                    });
+                }
+
+                ~PipelinedOracle(void) {
+                    jobs.Push({0, nullptr, nullptr});
+                    worker.join();
+                }
+
+                PipelinedOracle(const PipelinedOracle&) = delete;
+                PipelinedOracle& operator=(const PipelinedOracle&) = delete;
+
+                void Submit(Buffer& request, Buffer& response) {
+                    jobs.Push({++seq, &request, &response});
+                }
+
+                /* See GoHandle::RunBatch() */
+                std::optional<size_t> Wait(void) {
+                    const auto d = done.Pop();
+                    assert(d.seq == seq);
+                    return d.size;
+                }
+        };
+
+        /* Compile with -DFUZZER_PIPELINED to run the Go oracle in a
+         * worker thread
+         */
+#if defined(FUZZER_PIPELINED)
+        using Oracle = PipelinedOracle;
+#else
+        using Oracle = InlineOracle;
+#endif
+
+        template <class StorageT>
         inline void Run(const uint8_t* data, size_t size) {
-            Native_Eip4788_Reset();
             const uint8_t** data_ = &data;
-            Storage storage;
 
-            while ( true ) {
-                const auto input = Input::Extract(data_, size, storage);
-                if ( input == std::nullopt ) return;
+            static const bool initialized = [](void) {
+                Initialize();
+                return true;
+            }();
+            (void)initialized;
+
+            /* Reused across inputs to avoid reallocating */
+            static thread_local Arena arena;
+            static thread_local StorageT storage(&arena);
+            storage.Reset();
+            arena.Reset();
+
+            /* Exchanged with the Go oracle */
+            static thread_local Buffer request;
+            static thread_local Buffer response;
+            static thread_local std::vector<InputView> calls;
+            static thread_local std::vector<ExecutionResult> results;
+            request.clear();
+            calls.clear();
+            results.clear();
+
+            /* Each thread has its own instance of the Go oracle */
+            static thread_local Oracle oracle;
+
+            /* Decode all calls and hand them to the Go oracle first. It
+             * keeps its state across the calls, so it only needs each
+             * call's storage fills.
+             */
+            {
+                codec::Reader r(data_, size);
+                while ( true ) {
+                    const auto input = codec::Decode<InputView>(
+                            InputSchema, r, InputOptions);
+                    if ( input == std::nullopt ) break;
+
+                    input->Encode(request, InputOptions);
+                    calls.push_back(*input);
+                }
+            }
+
+            if ( calls.empty() ) return;
 
-                ExecutionResult cpp, native;
+            response.resize(4 + calls.size() * MaxResultSize);
+            oracle.Submit(request, response);
+
+            /* Meanwhile, run the other implementations */
+            for (const auto& input : calls) {
+                input.Fill(storage);
+#if defined(FUZZER_WITH_PYTHON)
+                /* The Python implementation starts from the pre-call state */
+                const auto jsonStr = input.Json(storage).dump();
+#endif
 
                 /* Run the C++ implementation */
                 {
-                    auto inp = *input;
+                    auto inp = input;
+                    storage.Track();
                     const auto ret = Eip4788::run(inp, storage);
+                    const auto& accesses = storage.Untrack();
                     const auto hash = storage.Hash();
-                    cpp = {.ret = ret, .hash = hash};
-                }
-
-                /* Run the canonical bytecode implementation */
-                {
-                    auto jsonStr = input->Json(storage).dump();
-                    const auto inp = util::ToGoSlice(
-                            jsonStr.data(),
-                            jsonStr.size());
-                    Native_Eip4788_Run(inp);
-                    const auto res = util::load(Native_Eip4788_Result());
-                    native = ExecutionResult::FromJson(res);
+                    results.push_back({.ret = ret, .hash = hash, .accesses = accesses});
                 }
 
-                assert(cpp == native);
-
 #if defined(FUZZER_WITH_PYTHON)
                 /* Run the Python implementation */
                 ExecutionResult py;
                 {
-                    const auto jsonStr = input->Json(storage).dump();
                     PyObject *pArgs, *pValue;
 
                     pArgs = PyTuple_New(1);
@@ -66,9 +283,33 @@ namespace harness {
                     Py_DECREF(pValue);
                     Py_DECREF(pArgs);
                 }
-                assert(py == native);
+                assert(py == results.back());
 #endif
             }
+
+            /* Compare against the canonical bytecode implementation, in
+             * call order, so the first mismatching call is reported
+             */
+            const auto response_size = oracle.Wait();
+
+            /* The results of the Go oracle exceed MaxResultSize, which no
+             * correct call to EIP-4788 can produce
+             */
+            assert(response_size != std::nullopt);
+
+            const uint8_t* p = response.data();
+            size_t remaining = *response_size;
+            codec::Reader r(&p, remaining);
+
+            const auto count = r.Int<uint32_t>();
+            assert(count != std::nullopt);
+            assert(*count == results.size());
+
+            for (const auto& cpp : results) {
+                const auto native = ExecutionResult::FromBinary(r);
+                assert(cpp == native);
+            }
+            assert(remaining == 0);
         }
     }
 }
@@ -1,23 +1,39 @@
 namespace harness {
     namespace invariants {
+        /* The input contains no storage fills */
+        constexpr codec::Options InputOptions{.fills = false};
+
+        template <class StorageT>
         inline void Run(const uint8_t* data, size_t size) {
-            Storage storage;
+            /* Reused across inputs to avoid reallocating */
+            static thread_local Arena arena;
+            static thread_local StorageT storage(&arena);
+            static thread_local std::pmr::map<uint256, uint256>
+                timestamp_calldata_map(&arena);
+            storage.Reset();
+            timestamp_calldata_map.clear();
+            arena.Reset();
+
             const uint8_t** data_ = &data;
-            std::optional<Input> prev_input;
-            std::map<uint256, uint256> timestamp_calldata_map;
+            std::optional<InputView> prev_input;
 
             while ( true ) {
-                const auto input = Input::Extract(data_, size, storage, false);
+                const auto input = InputView::Extract(
+                        data_, size, storage, InputOptions.fills);
                 if ( input == std::nullopt ) return;
 
                 const auto inp = *input;
-                const auto prev_storage_size = storage.MapRef().size();
+                const auto prev_storage_size = storage.Size();
+                const auto prev_storage_hash = storage.Hash();
+                const auto snapshot = storage.Snapshot();
                 const auto ret = Eip4788::run(inp, storage);
-                const auto cur_storage_size = storage.MapRef().size();
+                const auto cur_storage_size = storage.Size();
+                const auto changes = storage.Changes(snapshot);
+                storage.Commit();
 
                 if ( input->caller == constants::SYSTEM_ADDRESS ) {
                     timestamp_calldata_map[input->timestamp] =
-                        util::load(util::trim32(input->calldata));
+                        util::load(input->calldata);
 
                     /* Each call to set() should add either 0 or 2 entries
                      * to the storage
@@ -26,10 +42,15 @@ namespace harness {
                             cur_storage_size == prev_storage_size ||
                             cur_storage_size == prev_storage_size + 2);
 
+                    /* and write exactly two slots */
+                    assert(changes == 2);
+
                     ::invariants::set_invariants(ret);
                 } else {
                     /* Each call to get() should leave the storage unchanged */
+                    assert(changes == 0);
                     assert(cur_storage_size == prev_storage_size);
+                    assert(storage.Hash() == prev_storage_hash);
 
                     ::invariants::get_invariants(
                             inp,
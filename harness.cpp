@@ -3,6 +3,19 @@
 #include <cstdlib>
 #include <optional>
 #include <map>
+#include <span>
+#include <tuple>
+#include <random>
+#include <limits>
+#include <memory_resource>
+#include <memory>
+#include <bit>
+#include <array>
+#include <atomic>
+#include <thread>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
 #include <iostream>
 
 #include <boost/algorithm/hex.hpp>
@@ -26,11 +39,17 @@ using uint256 = intx::uint256;
 
 #include "constants.hpp"
 #include "util.hpp"
+#include "coverage.hpp"
+#include "arena.hpp"
+#include "spsc.hpp"
+#include "storage.hpp"
+#include "codec.hpp"
 #include "structs.hpp"
 #include "eip4788.hpp"
 #include "invariants.hpp"
 #include "harness-differential.hpp"
 #include "harness-invariants.hpp"
+#include "mutator.hpp"
 
 #ifdef NDEBUG
 # error "NDEBUG must not be set (asserts must be functional)"
@@ -142,13 +161,56 @@ extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv) {
 }
 #endif
 
-extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+/* The flat-array backend is the default; the map-based reference
+ * backend can be selected with -DFUZZER_MAP_STORAGE
+ */
+#if defined(FUZZER_MAP_STORAGE)
+using FuzzerStorage = Storage;
+#else
+using FuzzerStorage = DenseStorage;
+#endif
+
 #if defined(FUZZER_DIFFERENTIAL)
-    harness::differential::Run(data, size);
+namespace fuzzer_harness = harness::differential;
 #elif defined(FUZZER_INVARIANTS)
-    harness::invariants::Run(data, size);
+namespace fuzzer_harness = harness::invariants;
 #else
 # error "No harness specified"
 #endif
+
+extern "C" size_t LLVMFuzzerCustomMutator(
+        uint8_t* data,
+        size_t size,
+        size_t max_size,
+        unsigned int seed) {
+    return mutator::Mutate(
+            data,
+            size,
+            max_size,
+            seed,
+            fuzzer_harness::InputOptions);
+}
+
+extern "C" size_t LLVMFuzzerCustomCrossOver(
+        const uint8_t* data1,
+        size_t size1,
+        const uint8_t* data2,
+        size_t size2,
+        uint8_t* out,
+        size_t max_out_size,
+        unsigned int seed) {
+    return mutator::CrossOver(
+            data1,
+            size1,
+            data2,
+            size2,
+            out,
+            max_out_size,
+            seed,
+            fuzzer_harness::InputOptions);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    fuzzer_harness::Run<FuzzerStorage>(data, size);
     return 0;
 }
@@ -22,7 +22,7 @@ namespace invariants {
     namespace get {
         /* get() must always revert if input is not 32 bytes */
         static void revert_if_not_32(
-                const Input& input,
+                const InputView& input,
                 const ReturnValue& ret) {
             if ( input.calldata.size() != 32 ) {
                 assert(ret.reverted == true);
@@ -38,8 +38,8 @@ namespace invariants {
         }
 
         static void symmetry(
-                const Input& input,
-                const std::optional<Input>& prev_input,
+                const InputView& input,
+                const std::optional<InputView>& prev_input,
                 const ReturnValue& ret) {
             /* If there was a function call before the current one */
             if ( !prev_input ) {
@@ -65,7 +65,8 @@ namespace invariants {
             assert(ret.reverted == false);
 
             /* and get() should return set()'s (trimmed, zero-padded) calldata */
-            assert(ret.data == util::trim32(prev_input->calldata));
+            assert(ret.data.size() == 32);
+            assert(util::load(ret.data) == util::load(prev_input->calldata));
 
             /* Invariant in pseudocode:
              *
@@ -77,9 +78,9 @@ namespace invariants {
         }
 
         static void integrity(
-                const Input& input,
+                const InputView& input,
                 const ReturnValue& ret,
-                const std::map<uint256, uint256>& timestamp_calldata_map) {
+                const std::pmr::map<uint256, uint256>& timestamp_calldata_map) {
             if ( ret.reverted == true ) {
                 return;
             }
@@ -96,10 +97,10 @@ namespace invariants {
     }
 
     static void get_invariants(
-            const Input& input,
-            const std::optional<Input>& prev_input,
+            const InputView& input,
+            const std::optional<InputView>& prev_input,
             const ReturnValue& ret,
-            const std::map<uint256, uint256>& timestamp_calldata_map) {
+            const std::pmr::map<uint256, uint256>& timestamp_calldata_map) {
         get::revert_if_not_32(input, ret);
         get::return_32_if_not_revert(ret);
         get::symmetry(input, prev_input, ret);
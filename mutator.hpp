@@ -0,0 +1,384 @@
+extern "C" size_t LLVMFuzzerMutate(uint8_t* data, size_t size, size_t max_size);
+
+/* Structure-aware mutation of the fuzzer input.
+ *
+ * The input is decoded into a list of calls, mutated at the call level and
+ * encoded again, so that mutations never misalign the calls that follow.
+ */
+namespace mutator {
+    /* A call that owns its variable-length fields */
+    struct Call {
+        uint256 caller;
+        Buffer calldata;
+        Buffer fills;
+        uint64_t timestamp;
+        uint64_t blocknumber;
+
+        static Call FromView(const InputView& v) {
+            const auto fills = v.fills.Raw();
+            return Call{
+                .caller = v.caller,
+                .calldata = Buffer(v.calldata.begin(), v.calldata.end()),
+                .fills = Buffer(fills.begin(), fills.end()),
+                .timestamp = v.timestamp,
+                .blocknumber = v.blocknumber,
+            };
+        }
+
+        InputView View(void) const {
+            InputView ret;
+            ret.caller = caller;
+            ret.calldata = calldata;
+            ret.fills = codec::FillView(fills);
+            ret.timestamp = timestamp;
+            ret.blocknumber = blocknumber;
+            return ret;
+        }
+
+        bool IsSet(void) const {
+            return caller == constants::SYSTEM_ADDRESS;
+        }
+    };
+
+    using Calls = std::vector<Call>;
+
+    /* Decode as many calls as possible; trailing bytes are dropped */
+    static Calls Decode(
+            const uint8_t* data,
+            size_t size,
+            const codec::Options& options) {
+        Calls ret;
+        codec::Reader r(&data, size);
+
+        while ( true ) {
+            const auto v = codec::Decode<InputView>(InputSchema, r, options);
+            if ( v == std::nullopt ) break;
+            ret.push_back(Call::FromView(*v));
+        }
+
+        return ret;
+    }
+
+    static void Encode(
+            const Calls& calls,
+            Buffer& out,
+            const codec::Options& options) {
+        out.clear();
+        for (const auto& call : calls) {
+            call.View().Encode(out, options);
+        }
+    }
+
+    class Mutator {
+        private:
+            std::minstd_rand rng;
+            const codec::Options options;
+            Calls& calls;
+
+            /* Uniform in [0, n) */
+            size_t pick(const size_t n) {
+                return std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+            }
+
+            bool coin(void) {
+                return pick(2) == 0;
+            }
+
+            uint64_t random64(void) {
+                return (static_cast<uint64_t>(rng()) << 32) ^ rng();
+            }
+
+            static Buffer word(const uint256& v) {
+                return util::save(v);
+            }
+
+            std::optional<size_t> pick_set(void) {
+                std::vector<size_t> sets;
+                for (size_t i = 0; i < calls.size(); i++) {
+                    if ( calls[i].IsSet() ) sets.push_back(i);
+                }
+                if ( sets.empty() ) return std::nullopt;
+                return sets[pick(sets.size())];
+            }
+
+            /* A timestamp that maps to the same ring buffer slot as t */
+            uint64_t colliding_timestamp(const uint64_t t) {
+                const uint64_t modulus = constants::HISTORICAL_ROOTS_MODULUS[0];
+                const uint64_t distance = modulus * (1 + pick(4));
+                if ( coin() && t >= constants::FORK_TIMESTAMP + distance ) {
+                    return t - distance;
+                }
+                return t + distance;
+            }
+
+            uint64_t random_timestamp(void) {
+                if ( !calls.empty() && coin() ) {
+                    return colliding_timestamp(calls[pick(calls.size())].timestamp);
+                }
+                return constants::FORK_TIMESTAMP + pick(1 << 20);
+            }
+
+            Call random_call(void) {
+                Call ret{
+                    .caller = coin() ? constants::SYSTEM_ADDRESS : uint256(random64()),
+                    .calldata = word(random64()),
+                    .fills = {},
+                    .timestamp = random_timestamp(),
+                    .blocknumber = constants::LondonBlock + pick(1 << 20),
+                };
+
+                /* Prefer a get() of a timestamp that was set() */
+                if ( !ret.IsSet() ) {
+                    if ( const auto i = pick_set() ) {
+                        ret.calldata = word(calls[*i].timestamp);
+                    }
+                }
+
+                return ret;
+            }
+
+            bool insert_call(void) {
+                calls.insert(
+                        calls.begin() + pick(calls.size() + 1),
+                        random_call());
+                return true;
+            }
+
+            bool delete_call(void) {
+                if ( calls.size() < 2 ) return false;
+                calls.erase(calls.begin() + pick(calls.size()));
+                return true;
+            }
+
+            bool duplicate_call(void) {
+                const auto call = calls[pick(calls.size())];
+                calls.insert(calls.begin() + pick(calls.size() + 1), call);
+                return true;
+            }
+
+            bool swap_calls(void) {
+                if ( calls.size() < 2 ) return false;
+                std::swap(calls[pick(calls.size())], calls[pick(calls.size())]);
+                return true;
+            }
+
+            bool flip_caller(void) {
+                auto& call = calls[pick(calls.size())];
+                call.caller = call.IsSet() ?
+                    uint256(random64()) :
+                    constants::SYSTEM_ADDRESS;
+                return true;
+            }
+
+            /* get() the timestamp of an earlier set() */
+            bool get_of_set(void) {
+                const auto i = pick_set();
+                if ( i == std::nullopt ) return false;
+
+                const auto j = *i + 1 + pick(calls.size() - *i);
+                Call get = j < calls.size() ? calls[j] : random_call();
+                if ( get.IsSet() ) {
+                    get.caller = random64();
+                }
+                get.calldata = word(calls[*i].timestamp);
+
+                if ( j < calls.size() ) {
+                    calls[j] = get;
+                } else {
+                    calls.push_back(get);
+                }
+                return true;
+            }
+
+            bool collide_timestamp(void) {
+                if ( calls.size() < 2 ) return false;
+                calls[pick(calls.size())].timestamp =
+                    colliding_timestamp(calls[pick(calls.size())].timestamp);
+                return true;
+            }
+
+            bool mutate_calldata(void) {
+                auto& calldata = calls[pick(calls.size())].calldata;
+                const auto size = calldata.size();
+                const size_t max_size = std::min<size_t>(
+                        std::max<size_t>(size * 2, 64),
+                        std::numeric_limits<uint16_t>::max());
+                calldata.resize(max_size);
+                calldata.resize(LLVMFuzzerMutate(calldata.data(), size, max_size));
+                return true;
+            }
+
+            bool mutate_numbers(void) {
+                auto& call = calls[pick(calls.size())];
+                if ( coin() ) {
+                    call.timestamp = random_timestamp();
+                } else {
+                    call.blocknumber = constants::LondonBlock + pick(1 << 20);
+                }
+                return true;
+            }
+
+            bool mutate_fills(void) {
+                if ( options.fills == false ) return false;
+
+                auto& fills = calls[pick(calls.size())].fills;
+                const auto num = fills.size() / codec::FillView::RecordSize;
+
+                if ( num != 0 && coin() ) {
+                    const auto i = pick(num) * codec::FillView::RecordSize;
+                    fills.erase(
+                            fills.begin() + i,
+                            fills.begin() + i + codec::FillView::RecordSize);
+                    return true;
+                }
+
+                /* Mostly target the slots of an existing timestamp */
+                const auto t = calls[pick(calls.size())].timestamp;
+                uint256 key = uint256(t) % constants::HISTORICAL_ROOTS_MODULUS;
+                if ( coin() ) {
+                    key += constants::HISTORICAL_ROOTS_MODULUS;
+                } else if ( pick(4) == 0 ) {
+                    key = uint256(random64(), random64(), random64(), random64());
+                }
+                const uint256 value = coin() ? uint256(t) : uint256(random64());
+
+                codec::Writer w(fills);
+                w.Int(static_cast<uint16_t>(1));
+                w.Word(key);
+                w.Word(value);
+                return true;
+            }
+        public:
+            Mutator(
+                    const unsigned int seed,
+                    const codec::Options& options,
+                    Calls& calls) :
+                rng(seed), options(options), calls(calls) {
+            }
+
+            void Mutate(void) {
+                if ( calls.empty() ) {
+                    insert_call();
+                    return;
+                }
+
+                const auto num = 1 + pick(3);
+                for (size_t i = 0; i < num; ) {
+                    bool ok = false;
+                    switch ( pick(11) ) {
+                        case 0: ok = insert_call(); break;
+                        case 1: ok = delete_call(); break;
+                        case 2: ok = duplicate_call(); break;
+                        case 3: ok = swap_calls(); break;
+                        case 4: ok = flip_caller(); break;
+                        case 5: ok = get_of_set(); break;
+                        case 6: ok = collide_timestamp(); break;
+                        /* Weighted double */
+                        case 7:
+                        case 8: ok = mutate_calldata(); break;
+                        case 9: ok = mutate_numbers(); break;
+                        case 10: ok = mutate_fills(); break;
+                    }
+                    if ( ok ) i++;
+                }
+            }
+    };
+
+    static size_t Mutate(
+            uint8_t* data,
+            const size_t size,
+            const size_t max_size,
+            const unsigned int seed,
+            const codec::Options& options) {
+        /* Leave some of the work to libFuzzer's byte-level mutations */
+        if ( seed % 8 == 0 ) {
+            return LLVMFuzzerMutate(data, size, max_size);
+        }
+
+        auto calls = Decode(data, size, options);
+        Mutator(seed, options, calls).Mutate();
+
+        static thread_local Buffer out;
+        Encode(calls, out, options);
+        if ( out.size() > max_size ) {
+            return LLVMFuzzerMutate(data, size, max_size);
+        }
+
+        memcpy(data, out.data(), out.size());
+        return out.size();
+    }
+
+    /* Combine two call sequences at call boundaries, so that set()s from
+     * one parent can line up with get()s from the other
+     */
+    static Calls CrossOver(
+            const Calls& a,
+            const Calls& b,
+            const unsigned int seed,
+            const codec::Options& options) {
+        std::minstd_rand rng(seed);
+        const auto pick = [&](const size_t n) {
+            return std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+        };
+
+        Calls ret;
+
+        if ( pick(2) == 0 ) {
+            /* Prefix of a followed by suffix of b */
+            const auto i = pick(a.size() + 1);
+            const auto j = pick(b.size() + 1);
+            ret.insert(ret.end(), a.begin(), a.begin() + i);
+            ret.insert(ret.end(), b.begin() + j, b.end());
+        } else {
+            /* Interleave, preserving the order within each parent */
+            size_t i = 0, j = 0;
+            while ( i < a.size() || j < b.size() ) {
+                if ( j == b.size() || (i < a.size() && pick(2) == 0) ) {
+                    ret.push_back(a[i++]);
+                } else {
+                    ret.push_back(b[j++]);
+                }
+            }
+        }
+
+        /* Merge the storage fills of a call of one parent into a call of
+         * the result
+         */
+        if ( options.fills && !ret.empty() && pick(2) == 0 ) {
+            const auto& from = pick(2) == 0 ? a : b;
+            if ( !from.empty() ) {
+                const auto& fills = from[pick(from.size())].fills;
+                auto& to = ret[pick(ret.size())].fills;
+                to.insert(to.end(), fills.begin(), fills.end());
+            }
+        }
+
+        return ret;
+    }
+
+    static size_t CrossOver(
+            const uint8_t* data1,
+            const size_t size1,
+            const uint8_t* data2,
+            const size_t size2,
+            uint8_t* out,
+            const size_t max_out_size,
+            const unsigned int seed,
+            const codec::Options& options) {
+        auto calls = CrossOver(
+                Decode(data1, size1, options),
+                Decode(data2, size2, options),
+                seed,
+                options);
+
+        static thread_local Buffer encoded;
+        Encode(calls, encoded, options);
+        while ( encoded.size() > max_out_size ) {
+            calls.pop_back();
+            Encode(calls, encoded, options);
+        }
+
+        memcpy(out, encoded.data(), encoded.size());
+        return encoded.size();
+    }
+}
@@ -0,0 +1,92 @@
+package main
+
+/*
+#include <stdint.h>
+
+// Provided by libFuzzer. Weak, so that the oracle also links without it.
+void __sanitizer_cov_trace_cmp8(uint64_t arg1, uint64_t arg2) __attribute__((weak));
+
+// libFuzzer tells comparisons apart by the PC they are reported from, so
+// every comparison site in the contract gets its own function. The asm
+// statement makes the bodies differ, so that they are not merged, and
+// keeps the last report from becoming a tail call from the dispatcher.
+#define TRACE_CMP256_SITES 16
+
+#define TRACE_CMP256_SITE(i) \
+    static void trace_cmp256_##i(const uint64_t* a, const uint64_t* b) { \
+        __sanitizer_cov_trace_cmp8(a[0], b[0]); \
+        __sanitizer_cov_trace_cmp8(a[1], b[1]); \
+        __sanitizer_cov_trace_cmp8(a[2], b[2]); \
+        __sanitizer_cov_trace_cmp8(a[3], b[3]); \
+        __asm__ volatile("" : : "i"(i)); \
+    }
+
+TRACE_CMP256_SITE(0)
+TRACE_CMP256_SITE(1)
+TRACE_CMP256_SITE(2)
+TRACE_CMP256_SITE(3)
+TRACE_CMP256_SITE(4)
+TRACE_CMP256_SITE(5)
+TRACE_CMP256_SITE(6)
+TRACE_CMP256_SITE(7)
+TRACE_CMP256_SITE(8)
+TRACE_CMP256_SITE(9)
+TRACE_CMP256_SITE(10)
+TRACE_CMP256_SITE(11)
+TRACE_CMP256_SITE(12)
+TRACE_CMP256_SITE(13)
+TRACE_CMP256_SITE(14)
+TRACE_CMP256_SITE(15)
+
+static void (*const trace_cmp256_sites[TRACE_CMP256_SITES])(const uint64_t*, const uint64_t*) = {
+    trace_cmp256_0, trace_cmp256_1, trace_cmp256_2, trace_cmp256_3,
+    trace_cmp256_4, trace_cmp256_5, trace_cmp256_6, trace_cmp256_7,
+    trace_cmp256_8, trace_cmp256_9, trace_cmp256_10, trace_cmp256_11,
+    trace_cmp256_12, trace_cmp256_13, trace_cmp256_14, trace_cmp256_15,
+};
+
+static void trace_cmp256(int site, const uint64_t* a, const uint64_t* b) {
+    if ( __sanitizer_cov_trace_cmp8 == 0 ) {
+        return;
+    }
+    trace_cmp256_sites[site](a, b);
+}
+*/
+import "C"
+
+import (
+    "github.com/ethereum/go-ethereum/core/vm"
+    "github.com/holiman/uint256"
+    "unsafe"
+)
+
+/* Comparison site of every EQ in the contract, indexed by program
+ * counter. PUSH data is skipped, so that only real instructions count.
+ */
+var cmpSites = func() []int {
+    sites := make([]int, len(eip4788_contract_code))
+    next := 0
+    for pc := 0; pc < len(eip4788_contract_code); pc++ {
+        op := vm.OpCode(eip4788_contract_code[pc])
+        if op == vm.EQ {
+            if next == C.TRACE_CMP256_SITES {
+                panic("More EQ instructions than comparison sites")
+            }
+            sites[pc] = next
+            next++
+        } else if op >= vm.PUSH1 && op <= vm.PUSH32 {
+            pc += int(op - vm.PUSH1) + 1
+        }
+    }
+    return sites
+}()
+
+/* Report a 256-bit comparison made by the EQ at pc to libFuzzer one
+ * 64-bit limb at a time, like coverage::TraceCmp() in coverage.hpp
+ */
+func traceCmp256(pc uint64, a, b *uint256.Int) {
+    C.trace_cmp256(
+        C.int(cmpSites[pc]),
+        (*C.uint64_t)(unsafe.Pointer(&a[0])),
+        (*C.uint64_t)(unsafe.Pointer(&b[0])))
+}
@@ -0,0 +1,43 @@
+/* Lock-free single-producer single-consumer ring buffer of N items.
+ *
+ * Push() may only be called from one thread and Pop() from one other
+ * thread. Both block (using atomic waits, not locks) while the queue is
+ * full or empty, respectively.
+ */
+template <class T, size_t N>
+class SpscQueue {
+    private:
+        std::array<T, N> items;
+
+        /* Index of the next item to pop; written only by the consumer */
+        alignas(64) std::atomic<size_t> head{0};
+        /* Index of the next item to push; written only by the producer */
+        alignas(64) std::atomic<size_t> tail{0};
+    public:
+        void Push(const T& v) {
+            const auto t = tail.load(std::memory_order_relaxed);
+            while ( true ) {
+                const auto h = head.load(std::memory_order_acquire);
+                if ( t - h < N ) break;
+                head.wait(h, std::memory_order_acquire);
+            }
+
+            items[t % N] = v;
+            tail.store(t + 1, std::memory_order_release);
+            tail.notify_one();
+        }
+
+        T Pop(void) {
+            const auto h = head.load(std::memory_order_relaxed);
+            while ( true ) {
+                const auto t = tail.load(std::memory_order_acquire);
+                if ( t != h ) break;
+                tail.wait(t, std::memory_order_acquire);
+            }
+
+            const T ret = items[h % N];
+            head.store(h + 1, std::memory_order_release);
+            head.notify_one();
+            return ret;
+        }
+};
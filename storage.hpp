@@ -0,0 +1,627 @@
+namespace storage {
+    /* Number of slots the EIP-4788 contract can address */
+    constexpr size_t NumContractSlots =
+        (constants::HISTORICAL_ROOTS_MODULUS * 2)[0];
+    static_assert(NumContractSlots == constants::HISTORICAL_ROOTS_MODULUS * 2);
+    static_assert(NumContractSlots % 64 == 0);
+
+    /* A single storage access. For reads, old == value. */
+    struct Access {
+        uint256 address;
+        uint256 old;
+        uint256 value;
+
+        bool operator==(const Access& rhs) const = default;
+    };
+
+    /* Inline list of accesses. A single call to the contract reads or
+     * writes at most two slots.
+     */
+    class AccessList {
+        private:
+            std::array<Access, 4> items;
+            size_t count = 0;
+        public:
+            void Add(const Access& access) {
+                assert(count < items.size());
+                items[count++] = access;
+            }
+
+            void Clear(void) {
+                count = 0;
+            }
+
+            size_t Size(void) const {
+                return count;
+            }
+
+            const Access* begin(void) const {
+                return items.data();
+            }
+
+            const Access* end(void) const {
+                return items.data() + count;
+            }
+
+            bool operator==(const AccessList& rhs) const {
+                return std::equal(begin(), end(), rhs.begin(), rhs.end());
+            }
+    };
+
+    /* The slots read and written by a single call */
+    struct Accesses {
+        AccessList reads;
+        AccessList writes;
+
+        bool operator==(const Accesses& rhs) const = default;
+    };
+
+    /* Reference backend: every slot lives in a single ordered map */
+    class MapBackend {
+        private:
+            std::pmr::map<uint256, uint256> map;
+        public:
+            explicit MapBackend(std::pmr::memory_resource* resource) :
+                map(resource) {
+            }
+
+            const uint256* Find(const uint256& address) const {
+                const auto it = map.find(address);
+                return it == map.end() ? nullptr : &it->second;
+            }
+
+            /* Returns the slot and whether it was newly created */
+            std::pair<uint256*, bool> Insert(const uint256& address) {
+                const auto [it, inserted] = map.try_emplace(address);
+                return {&it->second, inserted};
+            }
+
+            void Erase(const uint256& address) {
+                map.erase(address);
+            }
+
+            void Clear(void) {
+                map.clear();
+            }
+
+            size_t Size(void) const {
+                return map.size();
+            }
+
+            /* Visit all slots in ascending key order */
+            template <class F>
+            void ForEach(F f) const {
+                for (const auto& kv : map) {
+                    f(kv.first, kv.second);
+                }
+            }
+    };
+
+    /* Open-addressing hash table from uint256 to uint256.
+     *
+     * Slots are arranged in groups of 16. Every slot has a control byte
+     * which is either Empty, Deleted, or the low 7 bits of the key's hash;
+     * a lookup compares all 16 control bytes of a group at once (SSE2) and
+     * only compares full keys for the slots whose tag matches.
+     *
+     * Iteration is unordered; ForEachSorted() sorts on demand.
+     */
+    class SlotTable {
+        private:
+            static constexpr size_t GroupSize = 16;
+            static constexpr int8_t Empty = -128;
+            static constexpr int8_t Deleted = -2;
+
+            struct Slot {
+                uint256 key;
+                uint256 value;
+            };
+
+            std::vector<int8_t> ctrl;
+            std::vector<Slot> slots;
+            size_t num_full = 0;
+            size_t num_deleted = 0;
+            /* Indices of the groups whose control bytes are not all Empty */
+            std::vector<uint32_t> dirty_groups;
+
+            /* Mix all four limbs, then apply the Murmur3 finalizer */
+            static uint64_t hash(const uint256& k) {
+                uint64_t h = 0;
+                for (size_t i = 0; i < 4; i++) {
+                    h = (h ^ k[i]) * 0x9e3779b97f4a7c15ULL;
+                    h ^= h >> 29;
+                }
+                h ^= h >> 33;
+                h *= 0xff51afd7ed558ccdULL;
+                h ^= h >> 33;
+                h *= 0xc4ceb9fe1a85ec53ULL;
+                h ^= h >> 33;
+                return h;
+            }
+
+            static int8_t tag(const uint64_t h) {
+                return static_cast<int8_t>(h & 0x7f);
+            }
+
+            /* Bitmask of the slots in the group whose control byte is t */
+            static uint32_t match(const int8_t* group, const int8_t t) {
+#if defined(__SSE2__)
+                const auto g = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(group));
+                return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(t)));
+#else
+                uint32_t mask = 0;
+                for (size_t i = 0; i < GroupSize; i++) {
+                    mask |= static_cast<uint32_t>(group[i] == t) << i;
+                }
+                return mask;
+#endif
+            }
+
+            /* Bitmask of the slots in the group that are Empty or Deleted */
+            static uint32_t match_free(const int8_t* group) {
+#if defined(__SSE2__)
+                return _mm_movemask_epi8(_mm_loadu_si128(
+                            reinterpret_cast<const __m128i*>(group)));
+#else
+                uint32_t mask = 0;
+                for (size_t i = 0; i < GroupSize; i++) {
+                    mask |= static_cast<uint32_t>(group[i] < 0) << i;
+                }
+                return mask;
+#endif
+            }
+
+            size_t num_groups(void) const {
+                return slots.size() / GroupSize;
+            }
+
+            /* Triangular probing visits every group once, because the
+             * number of groups is a power of two.
+             */
+            template <class F>
+            void probe(const uint64_t h, F f) const {
+                const size_t mask = num_groups() - 1;
+                size_t g = (h >> 7) & mask;
+                for (size_t i = 1; ; i++) {
+                    if ( f(g * GroupSize) ) {
+                        return;
+                    }
+                    g = (g + i) & mask;
+                }
+            }
+
+            size_t find(const uint256& key, const uint64_t h) const {
+                size_t ret = SIZE_MAX;
+                if ( slots.empty() ) {
+                    return ret;
+                }
+
+                const auto t = tag(h);
+                probe(h, [&](const size_t base) {
+                    for (auto m = match(&ctrl[base], t); m; m &= m - 1) {
+                        const auto idx = base + std::countr_zero(m);
+                        if ( slots[idx].key == key ) {
+                            ret = idx;
+                            return true;
+                        }
+                    }
+                    return match(&ctrl[base], Empty) != 0;
+                });
+
+                return ret;
+            }
+
+            /* Place a key known to be absent; returns its slot index */
+            size_t place(const uint256& key, const uint64_t h) {
+                size_t ret = 0;
+                probe(h, [&](const size_t base) {
+                    const auto m = match_free(&ctrl[base]);
+                    if ( m == 0 ) {
+                        return false;
+                    }
+                    ret = base + std::countr_zero(m);
+                    if ( match(&ctrl[base], Empty) == 0xFFFF ) {
+                        dirty_groups.push_back(base / GroupSize);
+                    }
+                    return true;
+                });
+
+                if ( ctrl[ret] == Deleted ) {
+                    num_deleted--;
+                }
+                ctrl[ret] = tag(h);
+                slots[ret].key = key;
+                num_full++;
+
+                return ret;
+            }
+
+            void rehash(const size_t capacity) {
+                auto old_ctrl = std::move(ctrl);
+                auto old_slots = std::move(slots);
+
+                ctrl.assign(capacity, Empty);
+                slots.assign(capacity, Slot{});
+                num_full = 0;
+                num_deleted = 0;
+                dirty_groups.clear();
+
+                for (size_t i = 0; i < old_slots.size(); i++) {
+                    if ( old_ctrl[i] >= 0 ) {
+                        const auto& slot = old_slots[i];
+                        slots[place(slot.key, hash(slot.key))].value = slot.value;
+                    }
+                }
+            }
+        public:
+            const uint256* Find(const uint256& key) const {
+                const auto idx = find(key, hash(key));
+                return idx == SIZE_MAX ? nullptr : &slots[idx].value;
+            }
+
+            /* Returns the slot and whether it was newly created */
+            std::pair<uint256*, bool> Insert(const uint256& key) {
+                const auto h = hash(key);
+                const auto idx = find(key, h);
+                if ( idx != SIZE_MAX ) {
+                    return {&slots[idx].value, false};
+                }
+
+                /* Keep the load factor (including tombstones) below 7/8 */
+                if ( (num_full + num_deleted + 1) * 8 > slots.size() * 7 ) {
+                    auto capacity = slots.empty() ? GroupSize : slots.size();
+                    /* Rehashing in place suffices if most are tombstones */
+                    if ( (num_full + 1) * 2 > capacity ) {
+                        capacity *= 2;
+                    }
+                    rehash(capacity);
+                }
+
+                auto& slot = slots[place(key, h)];
+                slot.value = 0;
+                return {&slot.value, true};
+            }
+
+            void Erase(const uint256& key) {
+                const auto idx = find(key, hash(key));
+                if ( idx == SIZE_MAX ) {
+                    return;
+                }
+                ctrl[idx] = Deleted;
+                num_full--;
+                num_deleted++;
+            }
+
+            /* Remove all keys in time proportional to the number of
+             * groups that were used, keeping the capacity
+             */
+            void Clear(void) {
+                for (const auto group : dirty_groups) {
+                    std::fill_n(&ctrl[group * GroupSize], GroupSize, Empty);
+                }
+                dirty_groups.clear();
+                num_full = 0;
+                num_deleted = 0;
+            }
+
+            size_t Size(void) const {
+                return num_full;
+            }
+
+            /* Visit all slots in ascending key order */
+            template <class F>
+            void ForEachSorted(F f) const {
+                std::vector<const Slot*> sorted;
+                sorted.reserve(num_full);
+                for (size_t i = 0; i < slots.size(); i++) {
+                    if ( ctrl[i] >= 0 ) {
+                        sorted.push_back(&slots[i]);
+                    }
+                }
+
+                std::sort(sorted.begin(), sorted.end(),
+                        [](const Slot* a, const Slot* b) {
+                            return a->key < b->key;
+                        });
+
+                for (const auto slot : sorted) {
+                    f(slot->key, slot->value);
+                }
+            }
+    };
+
+    /* Contract slots (< NumContractSlots) are kept in one contiguous array
+     * indexed by key, with a bitmap recording which of them have been set.
+     * Any other key (only ever written by the fuzzer) goes into a hash table.
+     */
+    class DenseBackend {
+        private:
+            struct Free {
+                void operator()(uint256* p) const {
+                    std::free(p);
+                }
+            };
+
+            /* calloc() of this size is served by fresh zero pages, so only
+             * the pages that are actually touched cost anything.
+             */
+            std::unique_ptr<uint256[], Free> values{
+                static_cast<uint256*>(
+                        std::calloc(NumContractSlots, sizeof(uint256)))};
+            std::array<uint64_t, NumContractSlots / 64> present{};
+            size_t num_present = 0;
+            /* Indices of the words of present that may be non-zero */
+            std::vector<uint32_t> dirty_words;
+            SlotTable sparse;
+
+            static bool is_dense(const uint256& address) {
+                return address < NumContractSlots;
+            }
+        public:
+            /* Everything is held in arrays that Clear() reuses, so no
+             * allocator is needed
+             */
+            explicit DenseBackend(std::pmr::memory_resource* resource) {
+                (void)resource;
+                assert(values != nullptr);
+            }
+
+            const uint256* Find(const uint256& address) const {
+                if ( is_dense(address) ) {
+                    const auto idx = static_cast<size_t>(address);
+                    if ( (present[idx / 64] >> (idx % 64)) & 1 ) {
+                        return &values[idx];
+                    }
+                    return nullptr;
+                }
+
+                return sparse.Find(address);
+            }
+
+            /* Returns the slot and whether it was newly created */
+            std::pair<uint256*, bool> Insert(const uint256& address) {
+                if ( is_dense(address) ) {
+                    const auto idx = static_cast<size_t>(address);
+                    const uint64_t bit = 1ULL << (idx % 64);
+                    if ( present[idx / 64] & bit ) {
+                        return {&values[idx], false};
+                    }
+                    if ( present[idx / 64] == 0 ) {
+                        dirty_words.push_back(idx / 64);
+                    }
+                    present[idx / 64] |= bit;
+                    num_present++;
+                    /* May hold a value from before the last Clear() */
+                    values[idx] = 0;
+                    return {&values[idx], true};
+                }
+
+                return sparse.Insert(address);
+            }
+
+            void Erase(const uint256& address) {
+                if ( is_dense(address) ) {
+                    const auto idx = static_cast<size_t>(address);
+                    const uint64_t bit = 1ULL << (idx % 64);
+                    if ( present[idx / 64] & bit ) {
+                        present[idx / 64] &= ~bit;
+                        num_present--;
+                    }
+                    return;
+                }
+
+                sparse.Erase(address);
+            }
+
+            /* Remove all keys in time proportional to the number of
+             * bitmap words that were used, keeping all capacity
+             */
+            void Clear(void) {
+                for (const auto word : dirty_words) {
+                    present[word] = 0;
+                }
+                dirty_words.clear();
+                num_present = 0;
+                sparse.Clear();
+            }
+
+            size_t Size(void) const {
+                return num_present + sparse.Size();
+            }
+
+            /* Visit all slots in ascending key order. Dense keys are all
+             * smaller than sparse keys, so the two can be visited in turn.
+             */
+            template <class F>
+            void ForEach(F f) const {
+                for (size_t i = 0; i < present.size(); i++) {
+                    auto word = present[i];
+                    while ( word ) {
+                        const auto idx = i * 64 + std::countr_zero(word);
+                        f(uint256(idx), values[idx]);
+                        word &= word - 1;
+                    }
+                }
+
+                sparse.ForEachSorted(f);
+            }
+    };
+}
+
+/* Mock EVM storage */
+template <class Backend>
+class BasicStorage {
+    private:
+        Backend backend;
+        uint64_t fingerprint = 0;
+
+        /* Undo journal of Set() calls, recorded while a snapshot is open */
+        struct JournalEntry {
+            uint256 address;
+            uint256 prev;
+            bool existed;
+        };
+        std::vector<JournalEntry> journal;
+        bool journaling = false;
+
+        /* Reads and writes recorded while tracking is enabled */
+        mutable storage::Accesses accesses;
+        bool tracking = false;
+
+        constexpr void bounds_check(const uint256& address) const {
+            assert(
+                    address <
+                    constants::HISTORICAL_ROOTS_MODULUS * 2);
+        }
+    public:
+        explicit BasicStorage(
+                std::pmr::memory_resource* resource =
+                    std::pmr::get_default_resource()) :
+            backend(resource) {
+        }
+
+        /* Remove all slots, snapshots and recorded accesses. Allocated
+         * capacity is kept for reuse.
+         */
+        void Reset(void) {
+            backend.Clear();
+            fingerprint = 0;
+            journal.clear();
+            journaling = false;
+            accesses.reads.Clear();
+            accesses.writes.Clear();
+            tracking = false;
+        }
+
+        uint256 Get(
+                const uint256& address,
+                const bool check_bounds = false) const {
+            if ( check_bounds ) {
+                bounds_check(address);
+            }
+
+            const auto p = backend.Find(address);
+            const uint256 v = p ? *p : 0;
+            if ( tracking ) {
+                accesses.reads.Add({address, v, v});
+            }
+            return v;
+        }
+
+        /* Returns the previous value */
+        uint256 Set(
+                const uint256& address,
+                const uint256& v,
+                const bool check_bounds = false) {
+            if ( check_bounds ) {
+                bounds_check(address);
+            }
+
+            const auto [slot, inserted] = backend.Insert(address);
+            if ( journaling ) {
+                journal.push_back({address, *slot, !inserted});
+            }
+            if ( tracking ) {
+                accesses.writes.Add({address, *slot, v});
+            }
+            const uint256 prev = *slot;
+            if ( !inserted ) {
+                fingerprint -= util::hash_slot(address, prev);
+            }
+            *slot = v;
+            fingerprint += util::hash_slot(address, v);
+            return prev;
+        }
+
+        /* Start recording writes. Returns an id that can be passed to
+         * Rollback() to restore the storage to its current state.
+         * Snapshots nest; rolling back to an id also discards all
+         * snapshots taken after it.
+         */
+        size_t Snapshot(void) {
+            journaling = true;
+            return journal.size();
+        }
+
+        /* Undo all Set() calls made since Snapshot() returned id */
+        void Rollback(const size_t id) {
+            assert(id <= journal.size());
+
+            while ( journal.size() > id ) {
+                const auto& e = journal.back();
+                fingerprint -= util::hash_slot(
+                        e.address,
+                        *backend.Find(e.address));
+                if ( e.existed ) {
+                    *backend.Insert(e.address).first = e.prev;
+                    fingerprint += util::hash_slot(e.address, e.prev);
+                } else {
+                    backend.Erase(e.address);
+                }
+                journal.pop_back();
+            }
+        }
+
+        /* Number of Set() calls made since Snapshot() returned id */
+        size_t Changes(const size_t id) const {
+            assert(id <= journal.size());
+            return journal.size() - id;
+        }
+
+        /* Keep all writes, drop all snapshots and stop recording */
+        void Commit(void) {
+            journal.clear();
+            journaling = false;
+        }
+
+        /* Start recording the slots read and written, discarding the
+         * previous record
+         */
+        void Track(void) {
+            accesses.reads.Clear();
+            accesses.writes.Clear();
+            tracking = true;
+        }
+
+        /* Stop recording and return the slots accessed since Track() */
+        const storage::Accesses& Untrack(void) {
+            tracking = false;
+            return accesses;
+        }
+
+        /* The storage hash is the sum of the xxHash digests of all
+         * (key, value) pairs. It does not depend on the order in which
+         * slots were set, and Set() keeps it up to date in O(1).
+         *
+         * eip4788.go maintains the same fingerprint for the Geth state.
+         */
+        uint64_t Hash(void) const {
+            return fingerprint;
+        }
+
+        size_t Size(void) const {
+            return backend.Size();
+        }
+
+        /* Visit all slots in ascending key order */
+        template <class F>
+        void ForEach(F f) const {
+            backend.ForEach(f);
+        }
+
+        static BasicStorage FromJson(const nlohmann::json& j) {
+            BasicStorage ret;
+
+            for (const auto& kv : j.items()) {
+                ret.Set(
+                    intx::from_string<uint256>(kv.key()),
+                    intx::from_string<uint256>(kv.value()));
+            }
+
+            return ret;
+        }
+};
+
+using Storage = BasicStorage<storage::MapBackend>;
+using DenseStorage = BasicStorage<storage::DenseBackend>;
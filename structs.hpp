@@ -1,148 +1,87 @@
-/* Mock EVM storage */
-class Storage {
-    private:
-        std::map<uint256, uint256> storage;
-        constexpr void bounds_check(const uint256& address) const {
-            assert(
-                    address <
-                    constants::HISTORICAL_ROOTS_MODULUS * 2);
-        }
-    public:
-        uint256 Get(
-                const uint256& address,
-                const bool check_bounds = false) const {
-            if ( check_bounds ) {
-                bounds_check(address);
-            }
-
-            if ( storage.count(address) ) {
-                return storage.at(address);
-            } else {
-                return 0;
-            }
-        }
-
-        void Set(
-                const uint256& address,
-                const uint256& v,
-                const bool check_bounds = false) {
-            if ( check_bounds ) {
-                bounds_check(address);
-            }
-            storage[address] = v;
-        }
-
-        /* Use xxHash to hash the storage */
-        uint64_t Hash(void) const {
-            auto h = XXH64_createState();
-            assert(XXH64_reset(h, 0) != XXH_ERROR);
-
-            for (const auto& kv: storage) {
-                util::hash(h, util::save(kv.first));
-                util::hash(h, util::save(kv.second));
-            }
-
-            const auto hash = XXH64_digest(h);
-            XXH64_freeState(h);
-            return hash;
-        }
-
-        const std::map<uint256, uint256>& MapRef(void) const {
-            return storage;
-        }
-
-        static Storage FromJson(const nlohmann::json& j) {
-            Storage ret;
-
-            for (const auto& kv : j.items()) {
-                ret.Set(
-                    intx::from_string<uint256>(kv.key()),
-                    intx::from_string<uint256>(kv.value()));
-            }
-
-            return ret;
-        }
-};
-
-class Input {
+/* A single call decoded from the fuzzer input. calldata and fills point
+ * into the fuzzer input, which must outlive the view.
+ */
+class InputView {
     public:
         uint256 caller;
-        Buffer calldata;
+        std::span<const uint8_t> calldata;
+        codec::FillView fills;
         uint64_t timestamp;
         uint64_t blocknumber;
 
-        /* Deserialize variables from the fuzzer input */
-        static std::optional<Input> Extract(
+        /* Deserialize variables from the fuzzer input and apply the
+         * storage fills to storage
+         */
+        template <class StorageT>
+        static std::optional<InputView> Extract(
                 const uint8_t** data,
                 size_t& remaining,
-                Storage& storage,
-                const bool fill_storage = true) {
-#define EXTRACT(var, T) \
-            const auto var = extract<T>(data, remaining); \
-            if ( var == std::nullopt ) return std::nullopt;
-#define EXTRACT2(var, T) \
-            EXTRACT(var, T); \
-            ret.var = *var;
-
-            using namespace util;
-
-            Input ret;
-
-            EXTRACT2(caller, uint256);
-            /* An address has only 20 bytes, so remove the upper 12 */
-            ret.caller &= constants::AddressMask;
-
-            EXTRACT2(calldata, Buffer);
-
-            if ( fill_storage == true ) {
-                /* Set zero or more storage entries */
-                while ( true ) {
-                    EXTRACT(continue_, bool);
-                    if ( *continue_ == false ) {
-                        break;
-                    }
-
-                    EXTRACT(address, uint256);
-                    EXTRACT(v, uint256);
-
-                    storage.Set(*address, *v);
-                }
-            }
+                StorageT& storage,
+                const bool fill_storage = true);
 
-            EXTRACT2(timestamp, uint64_t);
-            if ( ret.timestamp < constants::FORK_TIMESTAMP ) {
-                ret.timestamp = constants::FORK_TIMESTAMP;
-            }
+        /* Apply the storage fills to storage */
+        template <class StorageT>
+        void Fill(StorageT& storage) const;
 
-            EXTRACT2(blocknumber, uint64_t);
-            if ( ret.blocknumber < constants::LondonBlock ) {
-                ret.blocknumber = constants::LondonBlock;
-            }
+        /* Serialize to the fuzzer input format, appending to out */
+        void Encode(Buffer& out, const codec::Options& options = {}) const;
 
-            return ret;
-#undef EXTRACT
-#undef EXTRACT2
-        }
-
-        nlohmann::json Json(Storage& storage) const {
-            nlohmann::json ret;
-
-            ret["caller"] = util::save(caller);
-            ret["calldata"] = calldata;
-
-            nlohmann::json storage_;
-            for (const auto& kv : storage.MapRef()) {
-                storage_[intx::hex(kv.first)] = intx::hex(kv.second);
-            }
-            ret["storage"] = storage_;
-
-            ret["timestamp"] = timestamp;
-            ret["blocknumber"] = blocknumber;
-
-            return ret;
-        }
+        template <class StorageT>
+        nlohmann::json Json(const StorageT& storage) const;
 };
 
+/* Wire format of a call in the fuzzer input */
+constexpr auto InputSchema = std::make_tuple(
+        codec::Field<&InputView::caller, codec::wire::Address>{"caller"},
+        codec::Field<&InputView::calldata, codec::wire::Bytes>{"calldata"},
+        codec::Field<&InputView::fills, codec::wire::Fills>{nullptr},
+        codec::Field<
+            &InputView::timestamp,
+            codec::wire::U64AtLeast<constants::FORK_TIMESTAMP>>{"timestamp"},
+        codec::Field<
+            &InputView::blocknumber,
+            codec::wire::U64AtLeast<constants::LondonBlock>>{"blocknumber"});
+
+template <class StorageT>
+std::optional<InputView> InputView::Extract(
+        const uint8_t** data,
+        size_t& remaining,
+        StorageT& storage,
+        const bool fill_storage) {
+    codec::Reader r(data, remaining);
+    const auto ret = codec::Decode<InputView>(
+            InputSchema, r, {.fills = fill_storage});
+    if ( ret == std::nullopt ) return std::nullopt;
+
+    ret->Fill(storage);
+
+    return ret;
+}
+
+template <class StorageT>
+void InputView::Fill(StorageT& storage) const {
+    fills.ForEach([&](const uint256& address, const uint256& v) {
+        storage.Set(address, v);
+    });
+}
+
+inline void InputView::Encode(Buffer& out, const codec::Options& options) const {
+    codec::Encode(InputSchema, *this, out, options);
+}
+
+template <class StorageT>
+nlohmann::json InputView::Json(const StorageT& storage) const {
+    auto ret = codec::ToJson(InputSchema, *this);
+
+    nlohmann::json storage_;
+    storage.ForEach([&](const uint256& k, const uint256& v) {
+        storage_[intx::hex(k)] = intx::hex(v);
+    });
+    ret["storage"] = storage_;
+
+    return ret;
+}
+
 struct ReturnValue {
     bool reverted;
     Buffer data;
@@ -173,9 +112,24 @@ struct ReturnValue {
 struct ExecutionResult {
     ReturnValue ret;
     uint64_t hash;
+    storage::Accesses accesses;
 
     bool operator==(const ExecutionResult& rhs) const {
-        return ret == rhs.ret && hash == rhs.hash;
+        return ret == rhs.ret && hash == rhs.hash && accesses == rhs.accesses;
+    }
+
+    static storage::AccessList AccessListFromJson(const nlohmann::json& j) {
+        storage::AccessList ret;
+
+        for (const auto& a : j) {
+            ret.Add({
+                .address = util::load(util::unhex(a["Key"].get<std::string>())),
+                .old = util::load(util::unhex(a["Old"].get<std::string>())),
+                .value = util::load(util::unhex(a["New"].get<std::string>())),
+            });
+        }
+
+        return ret;
     }
 
     static ExecutionResult FromJson(const nlohmann::json& j) {
@@ -184,11 +138,48 @@ struct ExecutionResult {
                 .reverted = j["Ret"]["Reverted"].get<bool>(),
                 .data = util::unhex(j["Ret"]["Data"].get<std::string>()),
             },
-            .hash = j["Hash"].get<uint64_t>()
+            .hash = j["Hash"].get<uint64_t>(),
+            .accesses = {
+                .reads = AccessListFromJson(j["Reads"]),
+                .writes = AccessListFromJson(j["Writes"]),
+            },
         };
     }
 
     static ExecutionResult FromJson(const std::string& s) {
         return FromJson(nlohmann::json::parse(s));
     }
+
+    /* A single result in the response of the Go oracle; see
+     * ExecutionResult.encode() in eip4788.go for the layout
+     */
+    static ExecutionResult FromBinary(codec::Reader& r) {
+        const auto get = [](const auto v) {
+            assert(v != std::nullopt);
+            return *v;
+        };
+
+        const auto access_list = [&](void) {
+            storage::AccessList ret;
+            const auto num = get(r.Int<uint8_t>());
+            for (size_t i = 0; i < num; i++) {
+                const auto address = get(r.Word());
+                const auto old = get(r.Word());
+                const auto value = get(r.Word());
+                ret.Add({.address = address, .old = old, .value = value});
+            }
+            return ret;
+        };
+
+        ExecutionResult ret;
+        ret.ret.reverted = get(r.Int<uint8_t>()) != 0;
+        ret.hash = get(r.Int<uint64_t>());
+        const auto size = get(r.Int<uint32_t>());
+        const auto bytes = get(r.Take(size));
+        ret.ret.data = Buffer(bytes.begin(), bytes.end());
+        ret.accesses.reads = access_list();
+        ret.accesses.writes = access_list();
+
+        return ret;
+    }
 };
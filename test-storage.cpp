@@ -0,0 +1,138 @@
+#include <cstdint>
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <optional>
+#include <map>
+#include <memory_resource>
+#include <memory>
+#include <bit>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+#include <iostream>
+#include <random>
+
+#include <boost/algorithm/hex.hpp>
+#include <intx/intx.hpp>
+#include "json.hpp"
+
+extern "C" {
+    #include "xxhash.h"
+    #include "eip4788.h"
+}
+
+using Buffer = std::vector<uint8_t>;
+using uint256 = intx::uint256;
+
+#include "constants.hpp"
+#include "util.hpp"
+#include "storage.hpp"
+
+#ifdef NDEBUG
+# error "NDEBUG must not be set (asserts must be functional)"
+#endif
+
+/* Tests Storage::Snapshot() and Storage::Rollback() against copies of the
+ * storage taken at each snapshot, and that Storage::Reset() leaves nothing
+ * behind.
+ */
+
+/* Everything observable about a storage */
+struct State {
+    std::map<uint256, uint256> slots;
+    size_t size;
+    uint64_t hash;
+
+    bool operator==(const State& rhs) const = default;
+};
+
+template <class StorageT>
+static State state(const StorageT& storage) {
+    State ret{{}, storage.Size(), storage.Hash()};
+    storage.ForEach([&](const uint256& k, const uint256& v) {
+        ret.slots[k] = v;
+    });
+    assert(ret.slots.size() == ret.size);
+    return ret;
+}
+
+template <class StorageT>
+static void test(const char* name, const size_t rounds) {
+    std::mt19937_64 rng(1);
+
+    /* Mostly a few contract slots, so that writes overwrite each other,
+     * and sometimes a key outside the contract's range
+     */
+    const auto key = [&](void) {
+        if ( rng() % 8 == 0 ) {
+            return uint256(rng(), rng(), rng(), rng());
+        }
+        return uint256(rng() % 32);
+    };
+
+    /* Reused across rounds, like the harnesses do */
+    StorageT storage;
+
+    for (size_t round = 0; round < rounds; round++) {
+        storage.Reset();
+        assert(storage.Size() == 0);
+        assert(storage.Hash() == 0);
+
+        /* Nothing from the previous round shows up as the old value of
+         * a write
+         */
+        std::map<uint256, uint256> fills;
+        for (size_t i = rng() % 16; i > 0; i--) {
+            const auto k = key();
+            const uint256 v = rng();
+
+            storage.Track();
+            storage.Set(k, v);
+            const auto& writes = storage.Untrack().writes;
+            assert(writes.Size() == 1);
+            assert(writes.begin()->old == fills[k]);
+
+            fills[k] = v;
+        }
+
+        /* Nested snapshots, each followed by some writes */
+        std::vector<std::pair<size_t, State>> snapshots;
+        size_t writes = 0;
+        for (size_t i = 1 + rng() % 4; i > 0; i--) {
+            snapshots.push_back({storage.Snapshot(), state(storage)});
+            for (size_t j = rng() % 8; j > 0; j--) {
+                /* Writing zero sets the slot; it does not erase it */
+                storage.Set(key(), rng() % 4 == 0 ? 0 : rng());
+                writes++;
+            }
+        }
+        assert(storage.Changes(snapshots.front().first) == writes);
+
+        /* Roll back to a random snapshot, then to the first one */
+        const auto& mid = snapshots[rng() % snapshots.size()];
+        storage.Rollback(mid.first);
+        assert(state(storage) == mid.second);
+        assert(storage.Changes(mid.first) == 0);
+
+        storage.Rollback(snapshots.front().first);
+        assert(state(storage) == snapshots.front().second);
+
+        /* A committed write survives */
+        storage.Commit();
+        const auto k = key();
+        storage.Set(k, 1);
+        assert(storage.Get(k) == 1);
+    }
+
+    printf("%s: %zu rounds ok\n", name, rounds);
+}
+
+int main(int argc, char** argv) {
+    const size_t rounds = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000;
+
+    test<Storage>("Storage", rounds);
+    test<DenseStorage>("DenseStorage", rounds);
+
+    return 0;
+}
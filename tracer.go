@@ -4,10 +4,140 @@ import (
     "github.com/ethereum/go-ethereum/core/vm"
     "github.com/ethereum/go-ethereum/common"
     "math/big"
-    "golang.org/x/exp/slices"
+    "fmt"
+    "os"
+    "sync/atomic"
 )
 
-type Tracer struct {}
+import "C"
+
+/* Tracer modes, selected with the EIP4788_TRACER environment variable:
+ *
+ *   off      no tracer is installed
+ *   check    (default) assert the call depth and the opcode whitelist
+ *   profile  check, and also count executed opcodes and program counters
+ *
+ * Bytecode coverage for libFuzzer is recorded in check and profile mode.
+ *
+ * Storage accesses and the fingerprint are recorded by trackedState in
+ * every mode.
+ */
+const (
+    TracerOff = iota
+    TracerCheck
+    TracerProfile
+)
+
+/* Selected once at startup, see tracerModeFromEnv() */
+var tracerMode int
+
+func tracerModeFromEnv() int {
+    switch os.Getenv("EIP4788_TRACER") {
+    case "", "check":
+        return TracerCheck
+    case "off":
+        return TracerOff
+    case "profile":
+        return TracerProfile
+    default:
+        panic("Invalid EIP4788_TRACER")
+    }
+}
+
+/* One tracer per oracle. The profile is shared by all of them. */
+type Tracer struct {
+    oracle *Oracle
+}
+
+/* Opcode and program counter histograms, summed over all oracles */
+var profileOps [256]atomic.Uint64
+var profilePcs = make([]atomic.Uint64, len(eip4788_contract_code))
+
+func newTracer(oracle *Oracle) vm.EVMLogger {
+    if tracerMode == TracerOff {
+        return nil
+    }
+
+    return &Tracer{oracle: oracle}
+}
+
+/* libFuzzer extra counters provided by the harness, or nil. They are
+ * shared by all oracles; like libFuzzer's own counters, concurrent
+ * updates are not synchronized.
+ */
+var coverage []byte
+
+//export Native_Eip4788_SetCoverage
+func Native_Eip4788_SetCoverage(counters []byte) {
+    if len(counters) < 4 * len(eip4788_contract_code) {
+        panic("Coverage region too small")
+    }
+    coverage = counters
+}
+
+func hit(i int) {
+    /* Saturate rather than wrap to zero */
+    if coverage[i] != 0xFF {
+        coverage[i]++
+    }
+}
+
+/* Record coverage of the bytecode. The counters consist of four arrays
+ * indexed by program counter:
+ *
+ *   executed
+ *   JUMPI taken
+ *   JUMPI not taken
+ *   SLOAD of an empty slot
+ *
+ * The operands of EQ are also reported to libFuzzer's comparison tracing.
+ */
+func (l *Tracer) cover(pc uint64, op vm.OpCode, scope *vm.ScopeContext) {
+    n := uint64(len(eip4788_contract_code))
+    if pc >= n {
+        return
+    }
+
+    hit(int(pc))
+
+    switch op {
+    case vm.EQ:
+        traceCmp256(pc, scope.Stack.Back(0), scope.Stack.Back(1))
+    case vm.JUMPI:
+        if scope.Stack.Back(1).IsZero() {
+            hit(int(2 * n + pc))
+        } else {
+            hit(int(n + pc))
+        }
+    case vm.SLOAD:
+        key := common.Hash(scope.Stack.Back(0).Bytes32())
+        if l.oracle.state.GetState(BEACON_ROOTS_ADDRESS, key) == (common.Hash{}) {
+            hit(int(3 * n + pc))
+        }
+    }
+}
+
+/* Print the opcode and program counter histograms to stderr */
+//export Native_Eip4788_PrintProfile
+func Native_Eip4788_PrintProfile() {
+    if tracerMode != TracerProfile {
+        return
+    }
+
+    fmt.Fprintln(os.Stderr, "Opcodes:")
+    for op := range profileOps {
+        if count := profileOps[op].Load(); count != 0 {
+            fmt.Fprintf(os.Stderr, "  %-14v %d\n", vm.OpCode(op), count)
+        }
+    }
+
+    fmt.Fprintln(os.Stderr, "Program counters:")
+    for pc := range profilePcs {
+        if count := profilePcs[pc].Load(); count != 0 {
+            fmt.Fprintf(os.Stderr, "  0x%02x %-14v %d\n", pc, vm.OpCode(eip4788_contract_code[pc]), count)
+        }
+    }
+}
 
 func (l *Tracer) CaptureStart(
     env *vm.EVM,
@@ -29,9 +159,20 @@ func (l *Tracer) CaptureState(pc uint64,
         panic("Call depth should always be 1")
     }
 
-    if slices.Contains(opcode_whitelist, op) == false {
+    if opcode_whitelist[op] == false {
         panic("Executed opcode that is not in EIP-4788")
     }
+
+    if coverage != nil {
+        l.cover(pc, op, scope)
+    }
+
+    if tracerMode == TracerProfile {
+        profileOps[op].Add(1)
+        if pc < uint64(len(profilePcs)) {
+            profilePcs[pc].Add(1)
+        }
+    }
 }
 func (l *Tracer) CaptureFault(pc uint64,
     op vm.OpCode,
@@ -1,70 +1,16 @@
 namespace util {
-    static Buffer trim32(Buffer v) {
-        v.resize(32, 0);
-        return v;
-    }
-
     constexpr uint256 load(const uint8_t* data) {
         return intx::be::unsafe::load<uint256>(data);
     }
 
-    static uint256 load(const Buffer& v) {
-        return load(trim32(v).data());
-    }
-
-#define ADVANCE(s) *data += s; remaining -= s;
-    template <class T>
-    static std::optional<T> extract(const uint8_t** data, size_t& remaining) {
-        T ret;
-
-        if ( remaining < sizeof(ret) ) {
-            return std::nullopt;
-        }
-
-        std::array<uint8_t, sizeof(T)> bytes;
-        memcpy(bytes.data(), *data, bytes.size());
-        std::reverse(bytes.begin(), bytes.end());
-        memcpy(&ret, bytes.data(), sizeof(T));
-
-        ADVANCE(sizeof(ret));
-
-        return ret;
-    }
-
-    template <>
-    std::optional<bool> extract(const uint8_t** data, size_t& remaining) {
-        const auto ret = extract<uint16_t>(data, remaining);
-        if ( ret == std::nullopt ) return std::nullopt;
-
-        return (*ret % 2) ? true : false;
-    }
-
-    template <>
-    std::optional<uint256> extract(const uint8_t** data, size_t& remaining) {
-        if ( remaining < 32 ) return std::nullopt;
-
-        const auto ret = load(*data);
-
-        ADVANCE(32);
-
-        return ret;
-    }
-
-    template <>
-    std::optional<Buffer> extract(const uint8_t** data, size_t& remaining) {
-        const auto size = extract<uint16_t>(data, remaining);
-        if ( size == std::nullopt ) return std::nullopt;
-
-        if ( remaining < *size ) return std::nullopt;
-
-        Buffer ret(*size);
-        memcpy(ret.data(), *data, *size);
-
-        ADVANCE(*size);
-
-        return ret;
+    /* Load the first 32 bytes of v as a big-endian word, zero-padding
+     * if v is shorter. Does not allocate.
+     */
+    static uint256 load(const std::span<const uint8_t> v) {
+        uint8_t bytes[32] = {};
+        memcpy(bytes, v.data(), std::min(v.size(), sizeof(bytes)));
+        return load(bytes);
     }
-#undef ADVANCE
 
     static Buffer save(const uint256& v) {
         uint8_t bytes[32];
@@ -72,8 +18,15 @@ namespace util {
         return {bytes, bytes + 32};
     }
 
-    static void hash(XXH64_state_t* h, const Buffer& data) {
-        assert(XXH64_update(h, data.data(), data.size()) != XXH_ERROR);
+    /* Digest of a single storage slot: XXH64(key || value).
+     * Both are stored big-endian into one stack buffer and digested with
+     * a single call, so this never allocates.
+     */
+    static uint64_t hash_slot(const uint256& k, const uint256& v) {
+        uint8_t kv[64];
+        intx::be::unsafe::store(kv, k);
+        intx::be::unsafe::store(kv + 32, v);
+        return XXH64(kv, sizeof(kv), 0);
     }
 
     static Buffer unhex(const std::string& data) {
@@ -89,12 +42,6 @@ namespace util {
             .cap = static_cast<GoInt>(size)};
     }
 
-    std::string load(char* s) {
-        const std::string ret(s);
-        free(s);
-        return ret;
-    }
-
     constexpr uint256 checked_add(
             const uint256& a,
             const uint256& b) {